@@ -10,22 +10,407 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// depth_intensity
+NumericVector depth_intensity(RawVector frames, NumericVector offsets, NumericVector lengths, NumericVector min_range, NumericVector max_range, NumericVector depth, int window_size, std::string fun, double prob);
+RcppExport SEXP _sonaR_depth_intensity(SEXP framesSEXP, SEXP offsetsSEXP, SEXP lengthsSEXP, SEXP min_rangeSEXP, SEXP max_rangeSEXP, SEXP depthSEXP, SEXP window_sizeSEXP, SEXP funSEXP, SEXP probSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lengths(lengthsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type min_range(min_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type max_range(max_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type depth(depthSEXP);
+    Rcpp::traits::input_parameter< int >::type window_size(window_sizeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fun(funSEXP);
+    Rcpp::traits::input_parameter< double >::type prob(probSEXP);
+    rcpp_result_gen = Rcpp::wrap(depth_intensity(frames, offsets, lengths, min_range, max_range, depth, window_size, fun, prob));
+    return rcpp_result_gen;
+END_RCPP
+}
+// bottom_depth
+NumericVector bottom_depth(RawVector frames, NumericVector offsets, NumericVector lengths, NumericVector min_range, NumericVector max_range, std::string method, double threshold, double min_depth, int window_size);
+RcppExport SEXP _sonaR_bottom_depth(SEXP framesSEXP, SEXP offsetsSEXP, SEXP lengthsSEXP, SEXP min_rangeSEXP, SEXP max_rangeSEXP, SEXP methodSEXP, SEXP thresholdSEXP, SEXP min_depthSEXP, SEXP window_sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lengths(lengthsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type min_range(min_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type max_range(max_rangeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< double >::type min_depth(min_depthSEXP);
+    Rcpp::traits::input_parameter< int >::type window_size(window_sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(bottom_depth(frames, offsets, lengths, min_range, max_range, method, threshold, min_depth, window_size));
+    return rcpp_result_gen;
+END_RCPP
+}
+// frame_segments
+List frame_segments(RawVector frames, NumericVector offsets, NumericVector lengths, NumericVector min_range, NumericVector max_range, bool normalize);
+RcppExport SEXP _sonaR_frame_segments(SEXP framesSEXP, SEXP offsetsSEXP, SEXP lengthsSEXP, SEXP min_rangeSEXP, SEXP max_rangeSEXP, SEXP normalizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lengths(lengthsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type min_range(min_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type max_range(max_rangeSEXP);
+    Rcpp::traits::input_parameter< bool >::type normalize(normalizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(frame_segments(frames, offsets, lengths, min_range, max_range, normalize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// image_decimate
+NumericMatrix image_decimate(SEXP x, int row_factor, int col_factor, std::string fun, bool for_image);
+RcppExport SEXP _sonaR_image_decimate(SEXP xSEXP, SEXP row_factorSEXP, SEXP col_factorSEXP, SEXP funSEXP, SEXP for_imageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type row_factor(row_factorSEXP);
+    Rcpp::traits::input_parameter< int >::type col_factor(col_factorSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fun(funSEXP);
+    Rcpp::traits::input_parameter< bool >::type for_image(for_imageSEXP);
+    rcpp_result_gen = Rcpp::wrap(image_decimate(x, row_factor, col_factor, fun, for_image));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mosaic_create
+SEXP mosaic_create(double res, bool slant_range, bool normalize);
+RcppExport SEXP _sonaR_mosaic_create(SEXP resSEXP, SEXP slant_rangeSEXP, SEXP normalizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type res(resSEXP);
+    Rcpp::traits::input_parameter< bool >::type slant_range(slant_rangeSEXP);
+    Rcpp::traits::input_parameter< bool >::type normalize(normalizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(mosaic_create(res, slant_range, normalize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mosaic_add
+void mosaic_add(SEXP mosaic, std::vector < std::string > paths, int threads);
+RcppExport SEXP _sonaR_mosaic_add(SEXP mosaicSEXP, SEXP pathsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type mosaic(mosaicSEXP);
+    Rcpp::traits::input_parameter< std::vector < std::string > >::type paths(pathsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    mosaic_add(mosaic, paths, threads);
+    return R_NilValue;
+END_RCPP
+}
+// mosaic_grid
+NumericMatrix mosaic_grid(SEXP mosaic, std::string fun);
+RcppExport SEXP _sonaR_mosaic_grid(SEXP mosaicSEXP, SEXP funSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type mosaic(mosaicSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fun(funSEXP);
+    rcpp_result_gen = Rcpp::wrap(mosaic_grid(mosaic, fun));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mosaic_info
+List mosaic_info(SEXP mosaic);
+RcppExport SEXP _sonaR_mosaic_info(SEXP mosaicSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type mosaic(mosaicSEXP);
+    rcpp_result_gen = Rcpp::wrap(mosaic_info(mosaic));
+    return rcpp_result_gen;
+END_RCPP
+}
 // read_slx
-DataFrame read_slx(std::string path, int filesize, bool display_progress);
-RcppExport SEXP _sonaR_read_slx(SEXP pathSEXP, SEXP filesizeSEXP, SEXP display_progressSEXP) {
+DataFrame read_slx(std::string path, bool display_progress, bool read_frames, int threads, Nullable<NumericVector> record_offsets, Nullable<IntegerVector> channels, Nullable<NumericVector> time_range, Nullable<NumericVector> bbox);
+RcppExport SEXP _sonaR_read_slx(SEXP pathSEXP, SEXP display_progressSEXP, SEXP read_framesSEXP, SEXP threadsSEXP, SEXP record_offsetsSEXP, SEXP channelsSEXP, SEXP time_rangeSEXP, SEXP bboxSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
-    Rcpp::traits::input_parameter< int >::type filesize(filesizeSEXP);
     Rcpp::traits::input_parameter< bool >::type display_progress(display_progressSEXP);
-    rcpp_result_gen = Rcpp::wrap(read_slx(path, filesize, display_progress));
+    Rcpp::traits::input_parameter< bool >::type read_frames(read_framesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type record_offsets(record_offsetsSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type time_range(time_rangeSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type bbox(bboxSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_slx(path, display_progress, read_frames, threads, record_offsets, channels, time_range, bbox));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_read_many
+DataFrame slx_read_many(CharacterVector paths, bool display_progress, bool read_frames, int threads, Nullable<IntegerVector> channels, Nullable<NumericVector> time_range, Nullable<NumericVector> bbox);
+RcppExport SEXP _sonaR_slx_read_many(SEXP pathsSEXP, SEXP display_progressSEXP, SEXP read_framesSEXP, SEXP threadsSEXP, SEXP channelsSEXP, SEXP time_rangeSEXP, SEXP bboxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type paths(pathsSEXP);
+    Rcpp::traits::input_parameter< bool >::type display_progress(display_progressSEXP);
+    Rcpp::traits::input_parameter< bool >::type read_frames(read_framesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type time_range(time_rangeSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type bbox(bboxSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_read_many(paths, display_progress, read_frames, threads, channels, time_range, bbox));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_read_channels
+List slx_read_channels(std::string path, bool display_progress, bool read_frames, int threads, Nullable<IntegerVector> channels, Nullable<NumericVector> time_range, Nullable<NumericVector> bbox);
+RcppExport SEXP _sonaR_slx_read_channels(SEXP pathSEXP, SEXP display_progressSEXP, SEXP read_framesSEXP, SEXP threadsSEXP, SEXP channelsSEXP, SEXP time_rangeSEXP, SEXP bboxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< bool >::type display_progress(display_progressSEXP);
+    Rcpp::traits::input_parameter< bool >::type read_frames(read_framesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type time_range(time_rangeSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type bbox(bboxSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_read_channels(path, display_progress, read_frames, threads, channels, time_range, bbox));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_frame_matrix
+RawVector slx_frame_matrix(RawVector frames, NumericVector frame_offsets, NumericVector frame_lengths);
+RcppExport SEXP _sonaR_slx_frame_matrix(SEXP framesSEXP, SEXP frame_offsetsSEXP, SEXP frame_lengthsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type frame_offsets(frame_offsetsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type frame_lengths(frame_lengthsSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_frame_matrix(frames, frame_offsets, frame_lengths));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_profile
+SEXP slx_profile();
+RcppExport SEXP _sonaR_slx_profile() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(slx_profile());
+    return rcpp_result_gen;
+END_RCPP
+}
+// sidescan_grid
+NumericMatrix sidescan_grid(RawVector frames, NumericVector frame_offsets, NumericVector lengths, NumericVector x, NumericVector y, NumericVector heading, NumericVector min_range, NumericVector max_range, NumericVector depth, double res, std::string fun, bool slant_range, bool normalize, int threads);
+RcppExport SEXP _sonaR_sidescan_grid(SEXP framesSEXP, SEXP frame_offsetsSEXP, SEXP lengthsSEXP, SEXP xSEXP, SEXP ySEXP, SEXP headingSEXP, SEXP min_rangeSEXP, SEXP max_rangeSEXP, SEXP depthSEXP, SEXP resSEXP, SEXP funSEXP, SEXP slant_rangeSEXP, SEXP normalizeSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type frame_offsets(frame_offsetsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lengths(lengthsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type heading(headingSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type min_range(min_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type max_range(max_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type depth(depthSEXP);
+    Rcpp::traits::input_parameter< double >::type res(resSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fun(funSEXP);
+    Rcpp::traits::input_parameter< bool >::type slant_range(slant_rangeSEXP);
+    Rcpp::traits::input_parameter< bool >::type normalize(normalizeSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sidescan_grid(frames, frame_offsets, lengths, x, y, heading, min_range, max_range, depth, res, fun, slant_range, normalize, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sidescan_points
+DataFrame sidescan_points(RawVector frames, NumericVector frame_offsets, NumericVector lengths, NumericVector x, NumericVector y, NumericVector heading, NumericVector min_range, NumericVector max_range, NumericVector depth, bool slant_range, bool normalize);
+RcppExport SEXP _sonaR_sidescan_points(SEXP framesSEXP, SEXP frame_offsetsSEXP, SEXP lengthsSEXP, SEXP xSEXP, SEXP ySEXP, SEXP headingSEXP, SEXP min_rangeSEXP, SEXP max_rangeSEXP, SEXP depthSEXP, SEXP slant_rangeSEXP, SEXP normalizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type frame_offsets(frame_offsetsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lengths(lengthsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type heading(headingSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type min_range(min_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type max_range(max_rangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type depth(depthSEXP);
+    Rcpp::traits::input_parameter< bool >::type slant_range(slant_rangeSEXP);
+    Rcpp::traits::input_parameter< bool >::type normalize(normalizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(sidescan_points(frames, frame_offsets, lengths, x, y, heading, min_range, max_range, depth, slant_range, normalize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_cache_write
+void slx_cache_write(std::string path, List columns, Nullable<RawVector> frames, Nullable<NumericVector> frame_offsets, Nullable<NumericVector> frame_lengths, bool compress);
+RcppExport SEXP _sonaR_slx_cache_write(SEXP pathSEXP, SEXP columnsSEXP, SEXP framesSEXP, SEXP frame_offsetsSEXP, SEXP frame_lengthsSEXP, SEXP compressSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< List >::type columns(columnsSEXP);
+    Rcpp::traits::input_parameter< Nullable<RawVector> >::type frames(framesSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type frame_offsets(frame_offsetsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type frame_lengths(frame_lengthsSEXP);
+    Rcpp::traits::input_parameter< bool >::type compress(compressSEXP);
+    slx_cache_write(path, columns, frames, frame_offsets, frame_lengths, compress);
+    return R_NilValue;
+END_RCPP
+}
+// slx_cache_read
+List slx_cache_read(std::string path, Nullable<CharacterVector> columns);
+RcppExport SEXP _sonaR_slx_cache_read(SEXP pathSEXP, SEXP columnsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Nullable<CharacterVector> >::type columns(columnsSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_cache_read(path, columns));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_index
+DataFrame slx_index(std::string path, std::string sidecar, bool rebuild, bool write);
+RcppExport SEXP _sonaR_slx_index(SEXP pathSEXP, SEXP sidecarSEXP, SEXP rebuildSEXP, SEXP writeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type sidecar(sidecarSEXP);
+    Rcpp::traits::input_parameter< bool >::type rebuild(rebuildSEXP);
+    Rcpp::traits::input_parameter< bool >::type write(writeSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_index(path, sidecar, rebuild, write));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_lazy_open
+SEXP slx_lazy_open(std::string path);
+RcppExport SEXP _sonaR_slx_lazy_open(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_lazy_open(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_lazy_read
+DataFrame slx_lazy_read(SEXP lazy, NumericVector record_offsets, bool read_frames);
+RcppExport SEXP _sonaR_slx_lazy_read(SEXP lazySEXP, SEXP record_offsetsSEXP, SEXP read_framesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type lazy(lazySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_offsets(record_offsetsSEXP);
+    Rcpp::traits::input_parameter< bool >::type read_frames(read_framesSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_lazy_read(lazy, record_offsets, read_frames));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_open
+SEXP slx_open(std::string path, Nullable<IntegerVector> channels, Nullable<NumericVector> time_range, Nullable<NumericVector> bbox);
+RcppExport SEXP _sonaR_slx_open(SEXP pathSEXP, SEXP channelsSEXP, SEXP time_rangeSEXP, SEXP bboxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type time_range(time_rangeSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type bbox(bboxSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_open(path, channels, time_range, bbox));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_next_chunk
+SEXP slx_next_chunk(SEXP reader, int n, bool read_frames);
+RcppExport SEXP _sonaR_slx_next_chunk(SEXP readerSEXP, SEXP nSEXP, SEXP read_framesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type reader(readerSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< bool >::type read_frames(read_framesSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_next_chunk(reader, n, read_frames));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_close
+void slx_close(SEXP reader);
+RcppExport SEXP _sonaR_slx_close(SEXP readerSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type reader(readerSEXP);
+    slx_close(reader);
+    return R_NilValue;
+END_RCPP
+}
+// slx_tail
+DataFrame slx_tail(std::string path, double from, int previous, bool read_frames, Nullable<IntegerVector> channels, Nullable<NumericVector> time_range, Nullable<NumericVector> bbox);
+RcppExport SEXP _sonaR_slx_tail(SEXP pathSEXP, SEXP fromSEXP, SEXP previousSEXP, SEXP read_framesSEXP, SEXP channelsSEXP, SEXP time_rangeSEXP, SEXP bboxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< double >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< int >::type previous(previousSEXP);
+    Rcpp::traits::input_parameter< bool >::type read_frames(read_framesSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type time_range(time_rangeSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type bbox(bboxSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_tail(path, from, previous, read_frames, channels, time_range, bbox));
+    return rcpp_result_gen;
+END_RCPP
+}
+// slx_simulate
+double slx_simulate(std::string path, double n, IntegerVector channels, int format, int frame_length, int seed, double lon, double lat);
+RcppExport SEXP _sonaR_slx_simulate(SEXP pathSEXP, SEXP nSEXP, SEXP channelsSEXP, SEXP formatSEXP, SEXP frame_lengthSEXP, SEXP seedSEXP, SEXP lonSEXP, SEXP latSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< double >::type n(nSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< int >::type format(formatSEXP);
+    Rcpp::traits::input_parameter< int >::type frame_length(frame_lengthSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< double >::type lon(lonSEXP);
+    Rcpp::traits::input_parameter< double >::type lat(latSEXP);
+    rcpp_result_gen = Rcpp::wrap(slx_simulate(path, n, channels, format, frame_length, seed, lon, lat));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_sonaR_read_slx", (DL_FUNC) &_sonaR_read_slx, 3},
+    {"_sonaR_depth_intensity", (DL_FUNC) &_sonaR_depth_intensity, 9},
+    {"_sonaR_bottom_depth", (DL_FUNC) &_sonaR_bottom_depth, 9},
+    {"_sonaR_frame_segments", (DL_FUNC) &_sonaR_frame_segments, 6},
+    {"_sonaR_image_decimate", (DL_FUNC) &_sonaR_image_decimate, 5},
+    {"_sonaR_mosaic_create", (DL_FUNC) &_sonaR_mosaic_create, 3},
+    {"_sonaR_mosaic_add", (DL_FUNC) &_sonaR_mosaic_add, 3},
+    {"_sonaR_mosaic_grid", (DL_FUNC) &_sonaR_mosaic_grid, 2},
+    {"_sonaR_mosaic_info", (DL_FUNC) &_sonaR_mosaic_info, 1},
+    {"_sonaR_read_slx", (DL_FUNC) &_sonaR_read_slx, 8},
+    {"_sonaR_slx_read_many", (DL_FUNC) &_sonaR_slx_read_many, 7},
+    {"_sonaR_slx_read_channels", (DL_FUNC) &_sonaR_slx_read_channels, 7},
+    {"_sonaR_slx_frame_matrix", (DL_FUNC) &_sonaR_slx_frame_matrix, 3},
+    {"_sonaR_slx_profile", (DL_FUNC) &_sonaR_slx_profile, 0},
+    {"_sonaR_sidescan_grid", (DL_FUNC) &_sonaR_sidescan_grid, 14},
+    {"_sonaR_sidescan_points", (DL_FUNC) &_sonaR_sidescan_points, 11},
+    {"_sonaR_slx_cache_write", (DL_FUNC) &_sonaR_slx_cache_write, 6},
+    {"_sonaR_slx_cache_read", (DL_FUNC) &_sonaR_slx_cache_read, 2},
+    {"_sonaR_slx_index", (DL_FUNC) &_sonaR_slx_index, 4},
+    {"_sonaR_slx_lazy_open", (DL_FUNC) &_sonaR_slx_lazy_open, 1},
+    {"_sonaR_slx_lazy_read", (DL_FUNC) &_sonaR_slx_lazy_read, 3},
+    {"_sonaR_slx_open", (DL_FUNC) &_sonaR_slx_open, 4},
+    {"_sonaR_slx_next_chunk", (DL_FUNC) &_sonaR_slx_next_chunk, 3},
+    {"_sonaR_slx_close", (DL_FUNC) &_sonaR_slx_close, 1},
+    {"_sonaR_slx_tail", (DL_FUNC) &_sonaR_slx_tail, 7},
+    {"_sonaR_slx_simulate", (DL_FUNC) &_sonaR_slx_simulate, 8},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,211 @@
+// Echo intensity at the bottom and bottom detection, run over the packed frames of one channel
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include <algorithm>
+
+using namespace Rcpp;
+
+enum WindowStat { WINDOW_MEAN, WINDOW_MAX, WINDOW_PERCENTILE };
+
+static void check_frames(const RawVector& frames, const NumericVector& offsets, const NumericVector& lengths,
+                         const NumericVector& min_range, const NumericVector& max_range) {
+
+  R_xlen_t n = offsets.size();
+
+  if(lengths.size() != n || min_range.size() != n || max_range.size() != n){
+    stop("All record columns must have the same length");
+  }
+
+  for(R_xlen_t i = 0; i < n; i++){
+    if(offsets[i] < 0 || lengths[i] < 0 || offsets[i] + lengths[i] > frames.size()){
+      stop("Frame offset out of bounds for record " + std::to_string(i + 1));
+    }
+  }
+}
+
+// Type 7 quantile (the default of quantile()) of the samples in [first, last), reorders 'scratch'
+static double window_percentile(const unsigned char *first, const unsigned char *last, double prob,
+                                std::vector < unsigned char >& scratch) {
+
+  scratch.assign(first, last);
+
+  double h = (scratch.size() - 1) * prob;
+  size_t lower = (size_t)h;
+
+  std::nth_element(scratch.begin(), scratch.begin() + lower, scratch.end());
+  double value = scratch[lower];
+
+  if(lower + 1 < scratch.size() && h > lower){
+    double next = *std::min_element(scratch.begin() + lower + 1, scratch.end());
+    value += (h - lower) * (next - value);
+  }
+
+  return(value);
+}
+
+// [[Rcpp::export]]
+
+NumericVector depth_intensity(RawVector frames, NumericVector offsets, NumericVector lengths,
+                              NumericVector min_range, NumericVector max_range, NumericVector depth,
+                              int window_size=0, std::string fun="mean", double prob=0.5) {
+
+  check_frames(frames, offsets, lengths, min_range, max_range);
+
+  if(depth.size() != offsets.size()){
+    stop("All record columns must have the same length");
+  }
+
+  if(window_size < 0){
+    stop("'window_size' must be zero or positive");
+  }
+
+  WindowStat stat;
+
+  if(fun == "mean") stat = WINDOW_MEAN;
+  else if(fun == "max") stat = WINDOW_MAX;
+  else if(fun == "percentile") stat = WINDOW_PERCENTILE;
+  else stop("'fun' must be one of 'mean', 'max' or 'percentile'");
+
+  if(stat == WINDOW_PERCENTILE && !(prob >= 0 && prob <= 1)){
+    stop("'prob' must be between 0 and 1");
+  }
+
+  R_xlen_t n = offsets.size();
+
+  NumericVector out(no_init(n));
+
+  const unsigned char *src = frames.begin();
+  std::vector < unsigned char > scratch;
+
+  for(R_xlen_t i = 0; i < n; i++){
+
+    R_xlen_t length = (R_xlen_t)lengths[i];
+    double span = max_range[i] - min_range[i];
+
+    //1-based sample at the depth, as in the images built by sonar_image
+    double position = (depth[i] - min_range[i]) / span * length;
+
+    if(!(span > 0) || !(position >= 1) || !(position < length + 1)){
+      out[i] = NA_REAL;
+      continue;
+    }
+
+    R_xlen_t sample = (R_xlen_t)position;
+
+    //Windows are clamped to the frame so they never reach into the next record
+    const unsigned char *frame = src + (R_xlen_t)offsets[i];
+    const unsigned char *first = frame + std::max(sample - window_size, (R_xlen_t)1) - 1;
+    const unsigned char *last = frame + std::min(sample + window_size, length);
+
+    switch(stat){
+      case WINDOW_MEAN: {
+        unsigned int sum = 0;
+        for(const unsigned char *p = first; p < last; p++){
+          sum += *p;
+        }
+        out[i] = (double)sum / (last - first);
+        break;
+      }
+      case WINDOW_MAX:
+        out[i] = *std::max_element(first, last);
+        break;
+      case WINDOW_PERCENTILE:
+        out[i] = window_percentile(first, last, prob, scratch);
+        break;
+    }
+  }
+
+  return(out);
+
+}
+
+// [[Rcpp::export]]
+
+NumericVector bottom_depth(RawVector frames, NumericVector offsets, NumericVector lengths,
+                           NumericVector min_range, NumericVector max_range,
+                           std::string method="threshold", double threshold=100, double min_depth=0.5,
+                           int window_size=3) {
+
+  check_frames(frames, offsets, lengths, min_range, max_range);
+
+  if(method != "threshold" && method != "gradient"){
+    stop("'method' must be one of 'threshold' or 'gradient'");
+  }
+
+  if(window_size < 1){
+    stop("'window_size' must be positive");
+  }
+
+  bool gradient = method == "gradient";
+
+  R_xlen_t n = offsets.size();
+
+  NumericVector out(no_init(n));
+
+  const unsigned char *src = frames.begin();
+
+  for(R_xlen_t i = 0; i < n; i++){
+
+    R_xlen_t length = (R_xlen_t)lengths[i];
+    double span = max_range[i] - min_range[i];
+
+    out[i] = NA_REAL;
+
+    if(!(span > 0) || length == 0) continue;
+
+    const unsigned char *frame = src + (R_xlen_t)offsets[i];
+
+    //Samples above 'min_depth' hold the transducer ringdown and are never taken as the bottom
+    R_xlen_t start = (R_xlen_t)std::max((min_depth - min_range[i]) / span * length, 0.0);
+
+    R_xlen_t found = -1;
+
+    if(!gradient){
+
+      //First sample returning at least 'threshold'
+      for(R_xlen_t j = start; j < length; j++){
+        if(frame[j] >= threshold){
+          found = j;
+          break;
+        }
+      }
+
+    }else{
+
+      //Strongest rise from the 'window_size' samples above to the 'window_size' samples from j down,
+      //both sums are moved one sample at a time
+      R_xlen_t w = window_size;
+      R_xlen_t j = std::max(start, w);
+
+      if(j + w > length) continue;
+
+      long above = 0, below = 0;
+      for(R_xlen_t k = j - w; k < j; k++) above += frame[k];
+      for(R_xlen_t k = j; k < j + w; k++) below += frame[k];
+
+      long best = 0;
+
+      for(; ; j++){
+
+        if(below - above > best){
+          best = below - above;
+          found = j;
+        }
+
+        if(j + w >= length) break;
+
+        above += frame[j] - frame[j - w];
+        below += frame[j + w] - frame[j];
+      }
+    }
+
+    if(found >= 0){
+      out[i] = min_range[i] + (found + 1) * span / length;
+    }
+  }
+
+  return(out);
+
+}
@@ -0,0 +1,200 @@
+// Helpers for working with the packed frame data returned by read_slx and the images built from it
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+using namespace Rcpp;
+
+inline bool is_na_value(int x) { return x == NA_INTEGER; }
+inline bool is_na_value(double x) { return ISNAN(x); }
+
+// [[Rcpp::export]]
+
+List frame_segments(RawVector frames, NumericVector offsets, NumericVector lengths,
+                    NumericVector min_range, NumericVector max_range, bool normalize=false) {
+
+  R_xlen_t n = offsets.size();
+
+  if(lengths.size() != n || min_range.size() != n || max_range.size() != n){
+    stop("All record columns must have the same length");
+  }
+
+  const unsigned char *src = RAW(frames);
+  R_xlen_t frames_size = frames.size();
+
+  List out;
+
+  //A new image starts whenever the range changes, the same runs as rle(MaxRange)
+  for(R_xlen_t begin = 0; begin < n; ){
+
+    R_xlen_t end = begin + 1;
+    while(end < n && max_range[end] == max_range[begin]) end++;
+
+    R_xlen_t ncol = end - begin;
+    R_xlen_t nrow = 0;
+
+    for(R_xlen_t i = begin; i < end; i++){
+      if(offsets[i] < 0 || lengths[i] < 0 || offsets[i] + lengths[i] > frames_size){
+        stop("Frame offset out of bounds for record " + std::to_string(i + 1));
+      }
+      nrow = std::max(nrow, (R_xlen_t)lengths[i]);
+    }
+
+    NumericVector range = NumericVector::create(min_range[begin], max_range[begin]);
+
+    if(!normalize){
+
+      //One column per record, shorter frames are padded with NA
+      IntegerMatrix mat((int)nrow, (int)ncol);
+      std::fill(mat.begin(), mat.end(), NA_INTEGER);
+
+      for(R_xlen_t i = begin; i < end; i++){
+        const unsigned char *frame = src + (R_xlen_t)offsets[i];
+        int *col = mat.begin() + (i - begin) * nrow;
+        for(R_xlen_t j = 0; j < (R_xlen_t)lengths[i]; j++){
+          col[j] = frame[j];
+        }
+      }
+
+      mat.attr("range") = range;
+      out.push_back(mat, std::to_string(out.size() + 1));
+
+    }else{
+
+      //Each sample is divided by the mean of its row, rows are summed while the frames are copied.
+      //As with rowMeans, a row is NA when a frame in the segment is too short to reach it
+      NumericMatrix mat((int)nrow, (int)ncol);
+      std::vector < double > row_sum(nrow, 0);
+      std::vector < R_xlen_t > row_count(nrow, 0);
+
+      for(R_xlen_t i = begin; i < end; i++){
+        const unsigned char *frame = src + (R_xlen_t)offsets[i];
+        double *col = mat.begin() + (i - begin) * nrow;
+        R_xlen_t length = (R_xlen_t)lengths[i];
+        for(R_xlen_t j = 0; j < length; j++){
+          col[j] = frame[j];
+          row_sum[j] += frame[j];
+          row_count[j]++;
+        }
+        for(R_xlen_t j = length; j < nrow; j++){
+          col[j] = NA_REAL;
+        }
+      }
+
+      for(R_xlen_t j = 0; j < nrow; j++){
+        row_sum[j] = row_count[j] == ncol ? row_sum[j] / ncol : NA_REAL;
+      }
+
+      double *values = mat.begin();
+
+      for(R_xlen_t c = 0; c < ncol; c++){
+        for(R_xlen_t j = 0; j < nrow; j++){
+          values[c * nrow + j] /= row_sum[j];
+        }
+      }
+
+      mat.attr("range") = range;
+      out.push_back(mat, std::to_string(out.size() + 1));
+    }
+
+    begin = end;
+  }
+
+  return(out);
+
+}
+
+// Reduces each block of 'row_factor' x 'col_factor' cells of an image to its max or mean, NA cells are ignored
+template <typename T>
+static void decimate_blocks(const T *values, R_xlen_t nrow, R_xlen_t ncol, R_xlen_t row_factor, R_xlen_t col_factor,
+                            bool use_mean, bool for_image, double *out) {
+
+  R_xlen_t out_nrow = (nrow + row_factor - 1) / row_factor;
+  R_xlen_t out_ncol = (ncol + col_factor - 1) / col_factor;
+
+  std::vector < double > acc(out_nrow), count(out_nrow);
+
+  for(R_xlen_t oc = 0; oc < out_ncol; oc++){
+
+    std::fill(acc.begin(), acc.end(), use_mean ? 0 : R_NegInf);
+    std::fill(count.begin(), count.end(), 0);
+
+    R_xlen_t col_end = std::min((oc + 1) * col_factor, ncol);
+
+    //Columns are contiguous, so each block is reduced by sweeping down its columns
+    for(R_xlen_t c = oc * col_factor; c < col_end; c++){
+
+      const T *col = values + c * nrow;
+
+      for(R_xlen_t orow = 0; orow < out_nrow; orow++){
+
+        R_xlen_t row_end = std::min((orow + 1) * row_factor, nrow);
+        double a = acc[orow], k = count[orow];
+
+        for(R_xlen_t r = orow * row_factor; r < row_end; r++){
+          if(is_na_value(col[r])) continue;
+          double v = col[r];
+          a = use_mean ? a + v : std::max(a, v);
+          k++;
+        }
+
+        acc[orow] = a;
+        count[orow] = k;
+      }
+    }
+
+    for(R_xlen_t orow = 0; orow < out_nrow; orow++){
+
+      double v = count[orow] == 0 ? NA_REAL : (use_mean ? acc[orow] / count[orow] : acc[orow]);
+
+      //image() draws the first dimension along x and the second upwards, so pings become rows and the
+      //samples are flipped to have the surface at the top
+      if(for_image){
+        out[(out_nrow - 1 - orow) * out_ncol + oc] = v;
+      }else{
+        out[oc * out_nrow + orow] = v;
+      }
+    }
+  }
+}
+
+// [[Rcpp::export]]
+
+NumericMatrix image_decimate(SEXP x, int row_factor, int col_factor, std::string fun="max", bool for_image=false) {
+
+  if(row_factor < 1 || col_factor < 1){
+    stop("Decimation factors must be positive");
+  }
+
+  if(fun != "max" && fun != "mean"){
+    stop("'fun' must be one of 'max' or 'mean'");
+  }
+
+  bool use_mean = fun == "mean";
+
+  if(TYPEOF(x) == INTSXP){
+
+    IntegerMatrix mat(x);
+
+    R_xlen_t out_nrow = (mat.nrow() + row_factor - 1) / row_factor, out_ncol = (mat.ncol() + col_factor - 1) / col_factor;
+    NumericMatrix out(for_image ? out_ncol : out_nrow, for_image ? out_nrow : out_ncol);
+
+    decimate_blocks(mat.begin(), mat.nrow(), mat.ncol(), row_factor, col_factor, use_mean, for_image, out.begin());
+
+    return(out);
+
+  }else if(TYPEOF(x) == REALSXP){
+
+    NumericMatrix mat(x);
+
+    R_xlen_t out_nrow = (mat.nrow() + row_factor - 1) / row_factor, out_ncol = (mat.ncol() + col_factor - 1) / col_factor;
+    NumericMatrix out(for_image ? out_ncol : out_nrow, for_image ? out_nrow : out_ncol);
+
+    decimate_blocks(mat.begin(), mat.nrow(), mat.ncol(), row_factor, col_factor, use_mean, for_image, out.begin());
+
+    return(out);
+  }
+
+  stop("'x' must be an integer or numeric matrix");
+
+}
@@ -0,0 +1,355 @@
+// Sidescan mosaic built up from any number of logs, one file at a time
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include <atomic>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "sidescan.h"
+
+using namespace Rcpp;
+
+// Cells are grouped in square tiles which are only allocated once a sample lands in them
+#define MOSAIC_TILE_SIZE 256
+#define MOSAIC_TILE_CELLS (MOSAIC_TILE_SIZE * MOSAIC_TILE_SIZE)
+
+struct MosaicTile {
+
+  std::vector < double > sum;
+  std::vector < double > max;
+  std::vector < uint32_t > count;
+
+  MosaicTile() : sum(MOSAIC_TILE_CELLS, 0), max(MOSAIC_TILE_CELLS, 0), count(MOSAIC_TILE_CELLS, 0) {}
+
+  void merge(const MosaicTile& other) {
+    for(size_t c = 0; c < MOSAIC_TILE_CELLS; c++){
+      if(other.count[c] == 0) continue;
+      if(count[c] == 0 || other.max[c] > max[c]) max[c] = other.max[c];
+      sum[c] += other.sum[c];
+      count[c] += other.count[c];
+    }
+  }
+
+};
+
+// Tiles keyed by (column, row) of the tile in a global grid anchored at longitude 0, latitude 0
+typedef std::map < std::pair < int64_t, int64_t >, MosaicTile > MosaicTiles;
+
+struct Mosaic {
+
+  Mosaic(double res, bool slant_range, bool normalize) : res(res), slant_range(slant_range), normalize(normalize), files(0), pings(0) {}
+
+  double res;
+  bool slant_range, normalize;
+
+  MosaicTiles tiles;
+  std::mutex lock;
+
+  size_t files, pings;
+
+};
+
+inline int64_t floor_div(int64_t a, int64_t b) {
+  return(a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+// Adds samples to the tiles, consecutive samples of a ping usually fall in the same tile so the last one is kept at hand
+struct TileAccumulator {
+
+  double res;
+  MosaicTiles *tiles;
+  std::pair < int64_t, int64_t > key;
+  MosaicTile *tile;
+
+  void operator()(double lon, double lat, double value) {
+
+    int64_t cx = (int64_t)std::floor(lon / res);
+    int64_t cy = (int64_t)std::floor(lat / res);
+
+    std::pair < int64_t, int64_t > k(floor_div(cx, MOSAIC_TILE_SIZE), floor_div(cy, MOSAIC_TILE_SIZE));
+
+    if(tile == NULL || k != key){
+      key = k;
+      tile = &(*tiles)[k];
+    }
+
+    size_t cell = (size_t)(cx - k.first * MOSAIC_TILE_SIZE) + (size_t)(cy - k.second * MOSAIC_TILE_SIZE) * MOSAIC_TILE_SIZE;
+
+    if(tile->count[cell] == 0 || value > tile->max[cell]) tile->max[cell] = value;
+    tile->sum[cell] += value;
+    tile->count[cell]++;
+  }
+
+};
+
+// Header fields of the sidescan records needed to place their samples, frames stay in the mapped file
+struct SidescanRecords {
+
+  const unsigned char *base;
+  size_t size;
+  const std::vector < size_t > *offsets;
+
+  std::vector < double > frame_offsets, lengths, x, y, heading, min_range, max_range, depth;
+
+  template <typename Layout>
+  void visit() {
+
+    size_t n = offsets->size();
+
+    frame_offsets.resize(n); lengths.resize(n); x.resize(n); y.resize(n);
+    heading.resize(n); min_range.resize(n); max_range.resize(n); depth.resize(n);
+
+    for(size_t i = 0; i < n; i++){
+
+      const unsigned char *rec = base + (*offsets)[i];
+
+      size_t frame_start = (*offsets)[i] + Layout::HeaderSize;
+      size_t length = read_le<typename Layout::EchoLengthType>(rec + Layout::OriginalLengthOfEchoData);
+
+      //A frame cut short by the end of the log only contributes the samples that were written
+      frame_offsets[i] = frame_start;
+      lengths[i] = std::min(length, frame_start < size ? size - frame_start : 0);
+
+      x[i] = read_le<int32_t>(rec + Layout::XLowrance);
+      y[i] = read_le<int32_t>(rec + Layout::YLowrance);
+      heading[i] = read_le<float>(rec + Layout::GNSSHeading);
+      min_range[i] = read_le<float>(rec + Layout::MinRange) / FEET_PER_METRE;
+      max_range[i] = read_le<float>(rec + Layout::MaxRange) / FEET_PER_METRE;
+      depth[i] = read_le<float>(rec + Layout::WaterDepth) / FEET_PER_METRE;
+    }
+  }
+
+};
+
+// Georeferences the sidescan records of one log into 'tiles', returns an error message or an empty string.
+// Runs on worker threads so it must not touch the R API
+static std::string add_file(const std::string& path, const Mosaic& mosaic, MosaicTiles& tiles, size_t& pings) {
+
+  MappedFile file(path);
+
+  if(!file.is_open() || file.size() < FILE_HEADER_SIZE){
+    return("Unable to open file: " + path);
+  }
+
+  const unsigned char *base = file.data();
+  uint16_t format = read_le<uint16_t>(base);
+
+  if(!known_format(format)){
+    return("The file appears to be neither '.sl2' or '.sl3': " + path);
+  }
+
+  SlxFilter filter;
+  filter.channels.push_back(5);
+
+  std::vector < size_t > offsets = index_records_ahead(file, key_fields(format), filter);
+
+  SidescanRecords rec;
+  rec.base = base;
+  rec.size = file.size();
+  rec.offsets = &offsets;
+  visit_layout(format, rec);
+
+  SidescanPings p = {base, rec.frame_offsets.data(), rec.lengths.data(), rec.x.data(), rec.y.data(), rec.heading.data(),
+                     rec.min_range.data(), rec.max_range.data(), rec.depth.data(), (R_xlen_t)offsets.size(),
+                     mosaic.slant_range, NULL};
+
+  std::vector < double > means;
+
+  if(mosaic.normalize){
+    means = sample_means(p);
+    p.sample_mean = means.empty() ? NULL : &means[0];
+  }
+
+  TileAccumulator acc = {mosaic.res, &tiles, std::pair < int64_t, int64_t >(0, 0), NULL};
+
+  for(R_xlen_t i = 0; i < p.n; i++){
+    visit_samples(p, i, 0, (R_xlen_t)p.lengths[i], acc);
+  }
+
+  pings = offsets.size();
+
+  return("");
+}
+
+// [[Rcpp::export]]
+
+SEXP mosaic_create(double res, bool slant_range=false, bool normalize=false) {
+
+  if(!(res > 0)){
+    stop("'res' must be positive");
+  }
+
+  XPtr<Mosaic> mosaic(new Mosaic(res, slant_range, normalize), true);
+
+  return(mosaic);
+
+}
+
+// [[Rcpp::export]]
+
+void mosaic_add(SEXP mosaic, std::vector < std::string > paths, int threads=1) {
+
+  XPtr<Mosaic> m(mosaic);
+
+  if(m.get() == NULL){
+    stop("The mosaic is no longer valid, handles do not survive saveRDS or a new session. Create it again with sonar_mosaic()");
+  }
+
+  std::vector < std::string > files;
+
+  for(size_t i = 0; i < paths.size(); i++){
+    files.push_back(std::string(R_ExpandFileName(paths[i].c_str())));
+  }
+
+  std::vector < std::string > errors(files.size());
+  std::vector < size_t > pings(files.size(), 0);
+
+  //Workers take the next file, grid it into tiles of their own and fold them into the mosaic,
+  //so at most one file's worth of tiles per thread exists besides the mosaic itself
+  std::atomic < size_t > next(0);
+
+  auto work = [&]() {
+    for(size_t i = next++; i < files.size(); i = next++){
+
+      MosaicTiles local;
+
+      errors[i] = add_file(files[i], *m, local, pings[i]);
+
+      std::lock_guard < std::mutex > guard(m->lock);
+
+      for(MosaicTiles::iterator it = local.begin(); it != local.end(); ++it){
+        MosaicTiles::iterator target = m->tiles.find(it->first);
+        if(target == m->tiles.end()){
+          m->tiles.insert(std::make_pair(it->first, std::move(it->second)));
+        }else{
+          target->second.merge(it->second);
+        }
+      }
+    }
+  };
+
+  if(threads <= 1 || files.size() <= 1){
+    work();
+  }else{
+
+    std::vector < std::thread > workers;
+
+    for(int t = 0; t < threads && t < (int)files.size(); t++){
+      workers.push_back(std::thread(work));
+    }
+
+    for(size_t t = 0; t < workers.size(); t++){
+      workers[t].join();
+    }
+  }
+
+  std::string error;
+
+  for(size_t i = 0; i < files.size(); i++){
+    if(errors[i].empty()){
+      m->files++;
+      m->pings += pings[i];
+    }else if(error.empty()){
+      error = errors[i];
+    }
+  }
+
+  if(!error.empty()){
+    stop(error);
+  }
+
+}
+
+// [[Rcpp::export]]
+
+NumericMatrix mosaic_grid(SEXP mosaic, std::string fun="max") {
+
+  XPtr<Mosaic> m(mosaic);
+
+  if(m.get() == NULL){
+    stop("The mosaic is no longer valid, handles do not survive saveRDS or a new session. Create it again with sonar_mosaic()");
+  }
+
+  if(fun != "max" && fun != "mean" && fun != "count"){
+    stop("'fun' must be one of 'max', 'mean' or 'count'");
+  }
+
+  if(m->tiles.empty()){
+    stop("No sidescan samples have been added to the mosaic");
+  }
+
+  //Trim the output to the cells that hold samples
+  int64_t cx_min = std::numeric_limits < int64_t >::max(), cx_max = std::numeric_limits < int64_t >::min();
+  int64_t cy_min = cx_min, cy_max = cx_max;
+
+  for(MosaicTiles::const_iterator it = m->tiles.begin(); it != m->tiles.end(); ++it){
+    for(size_t c = 0; c < MOSAIC_TILE_CELLS; c++){
+      if(it->second.count[c] == 0) continue;
+      int64_t cx = it->first.first * MOSAIC_TILE_SIZE + (int64_t)(c % MOSAIC_TILE_SIZE);
+      int64_t cy = it->first.second * MOSAIC_TILE_SIZE + (int64_t)(c / MOSAIC_TILE_SIZE);
+      cx_min = std::min(cx_min, cx); cx_max = std::max(cx_max, cx);
+      cy_min = std::min(cy_min, cy); cy_max = std::max(cy_max, cy);
+    }
+  }
+
+  R_xlen_t ncol = (R_xlen_t)(cx_max - cx_min + 1);
+  R_xlen_t nrow = (R_xlen_t)(cy_max - cy_min + 1);
+
+  NumericMatrix out((int)nrow, (int)ncol);
+
+  double *values = out.begin();
+
+  std::fill(values, values + nrow * ncol, fun == "count" ? 0 : NA_REAL);
+
+  for(MosaicTiles::const_iterator it = m->tiles.begin(); it != m->tiles.end(); ++it){
+
+    const MosaicTile& tile = it->second;
+
+    for(size_t c = 0; c < MOSAIC_TILE_CELLS; c++){
+
+      if(tile.count[c] == 0) continue;
+
+      int64_t cx = it->first.first * MOSAIC_TILE_SIZE + (int64_t)(c % MOSAIC_TILE_SIZE);
+      int64_t cy = it->first.second * MOSAIC_TILE_SIZE + (int64_t)(c / MOSAIC_TILE_SIZE);
+
+      //Row 0 is the northern edge
+      R_xlen_t cell = (R_xlen_t)(cx - cx_min) * nrow + (R_xlen_t)(cy_max - cy);
+
+      if(fun == "max"){
+        values[cell] = tile.max[c];
+      }else if(fun == "mean"){
+        values[cell] = tile.sum[c] / tile.count[c];
+      }else{
+        values[cell] = tile.count[c];
+      }
+    }
+  }
+
+  out.attr("extent") = NumericVector::create(cx_min * m->res, (cx_max + 1) * m->res, cy_min * m->res, (cy_max + 1) * m->res);
+
+  return(out);
+
+}
+
+// [[Rcpp::export]]
+
+List mosaic_info(SEXP mosaic) {
+
+  XPtr<Mosaic> m(mosaic);
+
+  if(m.get() == NULL){
+    stop("The mosaic is no longer valid, handles do not survive saveRDS or a new session. Create it again with sonar_mosaic()");
+  }
+
+  return(List::create(
+    _["res"] = m->res,
+    _["files"] = (double)m->files,
+    _["pings"] = (double)m->pings,
+    _["tiles"] = (double)m->tiles.size()
+  ));
+
+}
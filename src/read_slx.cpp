@@ -3,9 +3,12 @@
 
 #include <Rcpp.h>
 
-#include <iostream>
-#include <fstream>
-#include <bitset>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "slx_decode.h"
 
 // [[Rcpp::depends(RcppProgress)]]
 #include <progress.hpp>
@@ -13,349 +16,624 @@
 
 using namespace Rcpp;
 
-#define MAX_BUFFER_SIZE (1024 * 1000)
+#define DECODE_BLOCK 1000
+
+// Runs decode(begin, end) over all records, either on the calling thread or split into one contiguous chunk per thread
+template <typename Decoder>
+static void run_decoder(Decoder decode, size_t n, int threads, bool display_progress) {
+
+  PROFILE_STAGE(PROFILE_DECODE);
+
+  Progress p(n, display_progress);
+
+  if(threads <= 1 || n < (size_t)threads * DECODE_BLOCK){
+
+    for(size_t begin = 0; begin < n; begin += DECODE_BLOCK){
+
+      size_t end = std::min(begin + DECODE_BLOCK, n);
+
+      decode(begin, end);
+
+      checkUserInterrupt();
+
+      p.increment(end - begin);
+    }
+
+    return;
+  }
+
+  //Worker threads must not touch the R API, progress and interrupts are handled here while they run
+  std::atomic < size_t > done(0);
+  std::atomic < int > finished(0);
+  std::atomic < bool > abort(false);
+
+  std::vector < std::thread > workers;
+  size_t chunk = (n + threads - 1) / threads;
+
+  for(int t = 0; t < threads; t++){
+
+    size_t chunk_begin = std::min(t * chunk, n);
+    size_t chunk_end = std::min(chunk_begin + chunk, n);
+
+    workers.push_back(std::thread([&, chunk_begin, chunk_end]() {
+      for(size_t begin = chunk_begin; begin < chunk_end && !abort; begin += DECODE_BLOCK){
+        size_t end = std::min(begin + DECODE_BLOCK, chunk_end);
+        decode(begin, end);
+        done += end - begin;
+      }
+      finished++;
+    }));
+  }
+
+  size_t reported = 0;
+
+  while (finished < threads) {
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    size_t current = done;
+    p.increment(current - reported);
+    reported = current;
+
+    if(Progress::check_abort()){
+      abort = true;
+    }
+  }
+
+  for(size_t t = 0; t < workers.size(); t++){
+    workers[t].join();
+  }
+
+  if(abort){
+    stop("Reading was interrupted by the user.");
+  }
+}
+
+// Starts reading the records of the block after [.., end) while this one is decoded. Skipped when the records are
+// far apart, as for subsets taken from an index, where it would read much more than is decoded
+static void prefetch_block(const MappedFile& file, const std::vector < size_t >& offsets, size_t end) {
+
+  size_t last = std::min(end + DECODE_BLOCK, offsets.size());
+
+  if(end >= last) return;
+
+  size_t begin_byte = offsets[end];
+  size_t end_byte = offsets[last - 1] + 0xFFFF;
+
+  if(end_byte > begin_byte && end_byte - begin_byte <= PREFETCH_WINDOW){
+    PROFILE_COUNT(PROFILE_PREFETCH_BYTES, end_byte - begin_byte);
+    file.prefetch(begin_byte, end_byte);
+  }
+}
+
+// Offsets of the records passing the filter. Offsets taken from an index are used as given, so only the requested
+// records are touched, otherwise ranges skipped over damaged records are added to 'skipped'
+static std::vector < size_t > select_records(const MappedFile& file, const SlxKeyFields& f,
+                                             const SlxFilter& filter, Nullable<NumericVector> record_offsets,
+                                             std::vector < SlxSkipped >& skipped) {
+
+  PROFILE_STAGE(PROFILE_INDEX);
+
+  if(record_offsets.isNull()){
+    return(index_records_ahead(file, f, filter, &skipped));
+  }
+
+  const unsigned char *base = file.data();
+  const size_t size = file.size();
+
+  NumericVector requested(record_offsets);
+
+  std::vector < size_t > offsets;
+  offsets.reserve(requested.size());
+
+  for(R_xlen_t i = 0; i < requested.size(); i++){
+    if(!(requested[i] >= FILE_HEADER_SIZE && requested[i] + f.header_size <= size)){
+      stop("Record offset " + std::to_string((long long)requested[i]) + " is outside the file");
+    }
+    PROFILE_COUNT(PROFILE_RECORDS_SCANNED, 1);
+    if(filter.matches(base + (size_t)requested[i], f)){
+      offsets.push_back((size_t)requested[i]);
+    }
+  }
+
+  return(offsets);
+}
 
 // [[Rcpp::export]]
 
-DataFrame read_slx(std::string path, int filesize, bool display_progress=true) {
-  
+DataFrame read_slx(std::string path, bool display_progress=true, bool read_frames=false, int threads=1,
+                   Nullable<NumericVector> record_offsets=R_NilValue, Nullable<IntegerVector> channels=R_NilValue,
+                   Nullable<NumericVector> time_range=R_NilValue, Nullable<NumericVector> bbox=R_NilValue) {
+
   std::string full_path = std::string(R_ExpandFileName(path.c_str()));
-  
-  const int ESTIMATED_RECS = filesize/2000;
-  
-  char buffer[MAX_BUFFER_SIZE];
-  std::vector < long > PositionOfFirstByteV; PositionOfFirstByteV.reserve(ESTIMATED_RECS);
-  std::vector < long > TotalLengthV; TotalLengthV.reserve(ESTIMATED_RECS);
-  std::vector < long > PreviousLengthV; PreviousLengthV.reserve(ESTIMATED_RECS);
-  std::vector < long > SurveyTypeV; SurveyTypeV.reserve(ESTIMATED_RECS);
-  std::vector < long > NumberOfCampaignInThisTypeV; NumberOfCampaignInThisTypeV.reserve(ESTIMATED_RECS);
-  std::vector < float > MinRangeV; MinRangeV.reserve(ESTIMATED_RECS);
-  std::vector < float > MaxRangeV; MaxRangeV.reserve(ESTIMATED_RECS);
-  std::vector < long > HardwareTimeV; HardwareTimeV.reserve(ESTIMATED_RECS);
-  std::vector < long > OriginalLengthOfEchoDataV; OriginalLengthOfEchoDataV.reserve(ESTIMATED_RECS);
-  std::vector < float > WaterDepthV; WaterDepthV.reserve(ESTIMATED_RECS);
-  std::vector < long > FrequencyV; FrequencyV.reserve(ESTIMATED_RECS);
-  std::vector < float > GNSSSpeedV; GNSSSpeedV.reserve(ESTIMATED_RECS);
-  std::vector < float > WaterTemperatureV; WaterTemperatureV.reserve(ESTIMATED_RECS);
-  std::vector < long > XLowranceV; XLowranceV.reserve(ESTIMATED_RECS);
-  std::vector < long > YLowranceV; YLowranceV.reserve(ESTIMATED_RECS);
-  std::vector < float > WaterSpeedV; WaterSpeedV.reserve(ESTIMATED_RECS);
-  std::vector < float > GNSSHeadingV; GNSSHeadingV.reserve(ESTIMATED_RECS);
-  std::vector < float > GNSSAltitudeV; GNSSAltitudeV.reserve(ESTIMATED_RECS);
-  std::vector < float > MagneticHeadingV; MagneticHeadingV.reserve(ESTIMATED_RECS);
-  std::vector < bool > headingValidV; headingValidV.reserve(ESTIMATED_RECS);
-  std::vector < bool > altitudeValidV; altitudeValidV.reserve(ESTIMATED_RECS);
-  std::vector < bool > gpsSpeedValidV; gpsSpeedValidV.reserve(ESTIMATED_RECS);
-  std::vector < bool > waterTempValidV; waterTempValidV.reserve(ESTIMATED_RECS);
-  std::vector < bool > positionValidV; positionValidV.reserve(ESTIMATED_RECS);
-  std::vector < bool > waterSpeedValidV; waterSpeedValidV.reserve(ESTIMATED_RECS);
-  std::vector < bool > trackValidV; trackValidV.reserve(ESTIMATED_RECS);
-  std::vector < long > MillisecondsV; MillisecondsV.reserve(ESTIMATED_RECS);
-  
+
   DataFrame out;
-  
-  ::std::ifstream in;
-  in.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
-  in.open(full_path, ::std::ifstream::in | ::std::ios::binary);
-  
-  uint16_t format;
-  in.read((char *)&format, sizeof(format));
-  
-  uint16_t version;
-  in.read((char *)&version, sizeof(version));
-  
-  uint16_t blockSize;
-  in.read((char *)&blockSize, sizeof(blockSize));
-  
-  in.seekg(8); 
-  
-  int i;
-  
-  Progress p(ESTIMATED_RECS, display_progress);
-  
-  if(format == 2){
-    
-    while (!(in.tellg() == -1)) {
-      
-      std::streampos recStart = in.tellg();
-      
-      uint32_t PositionOfFirstByte;
-      in.seekg(recStart); in.seekg(0, std::ios_base::cur);
-      in.read((char *)&PositionOfFirstByte, sizeof(PositionOfFirstByte));
-      
-      PositionOfFirstByteV.push_back(PositionOfFirstByte);
-      
-      uint16_t TotalLength, PreviousLength, SurveyType, PacketSize;
-      in.seekg(recStart); in.seekg(28, std::ios_base::cur);
-      in.read((char *)&TotalLength, sizeof(TotalLength));
-      in.read((char *)&PreviousLength, sizeof(PreviousLength));
-      in.read((char *)&SurveyType, sizeof(SurveyType));
-      in.read((char *)&PacketSize, sizeof(PacketSize));
-      
-      TotalLengthV.push_back(TotalLength);
-      PreviousLengthV.push_back(PreviousLength);
-      SurveyTypeV.push_back(SurveyType);
-      OriginalLengthOfEchoDataV.push_back(PacketSize); 
-      
-      uint32_t NumberOfCampaignInThisType;
-      float MinRange, MaxRange;
-      //in.seekg(recStart); in.seekg(36, std::ios_base::cur);
-      in.read((char *)&NumberOfCampaignInThisType, sizeof(NumberOfCampaignInThisType));
-      in.read((char *)&MinRange, sizeof(MinRange));
-      in.read((char *)&MaxRange, sizeof(MaxRange));
-      
-      NumberOfCampaignInThisTypeV.push_back(NumberOfCampaignInThisType);
-      MinRangeV.push_back(MinRange);
-      MaxRangeV.push_back(MaxRange);
-      
-      //uint16_t Frequency;
-      uint8_t Frequency;
-      in.seekg(recStart); in.seekg(53, std::ios_base::cur);
-      in.read((char *)&Frequency, sizeof(Frequency));
-      
-      FrequencyV.push_back(Frequency);
-      
-      uint32_t HardwareTime;
-      float WaterDepth;
-      
-      in.seekg(recStart); in.seekg(60, std::ios_base::cur);
-      in.read((char *)&HardwareTime, sizeof(HardwareTime));
-      in.read((char *)&WaterDepth, sizeof(WaterDepth));
-      
-      HardwareTimeV.push_back(HardwareTime);
-      WaterDepthV.push_back(WaterDepth);
-      
-      float GNSSSpeed, WaterTemperature;
-      uint32_t XLowrance, YLowrance;
-      float WaterSpeed, GNSSHeading, GNSSAltitude, MagneticHeading;
-      
-      in.seekg(recStart); in.seekg(100, std::ios_base::cur);
-      in.read((char *)&GNSSSpeed, sizeof(GNSSSpeed));
-      in.read((char *)&WaterTemperature, sizeof(WaterTemperature));
-      in.read((char *)&XLowrance, sizeof(XLowrance));
-      in.read((char *)&YLowrance, sizeof(YLowrance));
-      in.read((char *)&WaterSpeed, sizeof(WaterSpeed));
-      in.read((char *)&GNSSHeading, sizeof(GNSSHeading));
-      in.read((char *)&GNSSAltitude, sizeof(GNSSAltitude));
-      in.read((char *)&MagneticHeading, sizeof(MagneticHeading));
-      
-      GNSSSpeedV.push_back(GNSSSpeed);
-      WaterTemperatureV.push_back(WaterTemperature);
-      XLowranceV.push_back(XLowrance);
-      YLowranceV.push_back(YLowrance);
-      WaterSpeedV.push_back(WaterSpeed);
-      GNSSHeadingV.push_back(GNSSHeading);
-      GNSSAltitudeV.push_back(GNSSAltitude);
-      MagneticHeadingV.push_back(MagneticHeading);
-      
-      std::bitset<16> flags;
-      in.read((char *)&flags, sizeof(flags));
-      
-      headingValidV.push_back(flags.test(0));
-      altitudeValidV.push_back(flags.test(1));
-      gpsSpeedValidV.push_back(flags.test(9));
-      waterTempValidV.push_back(flags.test(10));
-      positionValidV.push_back(flags.test(12));
-      waterSpeedValidV.push_back(flags.test(14));
-      trackValidV.push_back(flags.test(15));
-      
-      uint32_t Milliseconds;
-      in.seekg(recStart); in.seekg(140, std::ios_base::cur);
-      in.read((char *)&Milliseconds, sizeof(Milliseconds));
-      
-      MillisecondsV.push_back(Milliseconds);
-      
-      in.seekg(recStart); 
-      in.seekg(TotalLength, std::ios_base::cur);
-      
-      if (i % 1000 == 0){
-        checkUserInterrupt();
+
+  PROFILE_RESET();
+
+  MappedFile file(full_path);
+
+  if(!file.is_open() || file.size() < FILE_HEADER_SIZE){
+    stop("Unable to open file: " + full_path);
+  }
+
+  const unsigned char *base = file.data();
+  const size_t size = file.size();
+
+  PROFILE_COUNT(PROFILE_FILE_BYTES, size);
+
+  uint16_t format = read_le<uint16_t>(base);
+  uint16_t version = read_le<uint16_t>(base + 2);
+  uint16_t blockSize = read_le<uint16_t>(base + 4);
+
+  if(!known_format(format)){
+    stop("The file appears to be neither '.sl2' or '.sl3'.");
+  }
+
+  SlxKeyFields f = key_fields(format);
+  SlxFilter filter = make_filter(channels, time_range, bbox);
+
+  //First pass: offsets of the records passing the filter, which gives the exact number of records so every column is
+  //allocated once at its final size and lets the decoding be split up
+  std::vector < SlxSkipped > skipped;
+  std::vector < size_t > offsets = select_records(file, f, filter, record_offsets, skipped);
+
+  size_t n = offsets.size();
+
+  SlxColumns cols(n);
+
+  //Echo data is packed into one contiguous block, the position of each frame follows from the lengths before it
+  RawVector frames;
+  NumericVector frame_offsets;
+
+  if(read_frames){
+    frame_offsets = NumericVector(no_init(n));
+    frames = RawVector(no_init((R_xlen_t)frame_layout(base, format, offsets, frame_offsets.begin())));
+  }
+
+  unsigned char *frames_ptr = read_frames ? frames.begin() : NULL;
+  const double *frame_offsets_ptr = read_frames ? frame_offsets.begin() : NULL;
+
+  //Second pass: decode headers and frames into the preallocated columns
+  run_decoder([&](size_t begin, size_t end) {
+    prefetch_block(file, offsets, end);
+    decode_records(format, base, size, offsets, begin, end, cols, frames_ptr, frame_offsets_ptr);
+  }, n, threads, display_progress);
+
+  out = slx_dataframe(cols, format, version, blockSize);
+
+  out.attr("skipped") = skipped_dataframe(skipped);
+
+  if(read_frames){
+    PROFILE_COUNT(PROFILE_FRAME_BYTES, frames.size());
+    out.attr("frames") = frames;
+    out.attr("frame_offsets") = frame_offsets;
+  }
+
+  return(out);
+
+}
+
+// One of the logs read together by slx_read_many, its rows start at 'row_start' in the combined table
+struct SlxBatchFile {
+
+  explicit SlxBatchFile(const std::string& path) : file(path), row_start(0), frame_start(0) {}
+
+  MappedFile file;
+  uint16_t format, version, blockSize;
+  std::vector < size_t > offsets;
+  std::vector < SlxSkipped > skipped;
+  size_t row_start, frame_start;
+
+};
+
+// Indexes the files concurrently, each worker takes the largest file not yet started so big logs are spread over the
+// threads instead of ending up queued behind each other
+static void index_files(std::vector < std::unique_ptr < SlxBatchFile > >& files, const SlxFilter& filter, int threads) {
+
+  PROFILE_STAGE(PROFILE_INDEX);
+
+  std::vector < size_t > order(files.size());
+
+  for(size_t k = 0; k < files.size(); k++){
+    order[k] = k;
+  }
+
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return files[a]->file.size() > files[b]->file.size(); });
+
+  std::atomic < size_t > next(0);
+
+  auto work = [&]() {
+    for(size_t i = next++; i < order.size(); i = next++){
+      SlxBatchFile& b = *files[order[i]];
+      b.offsets = index_records_ahead(b.file, key_fields(b.format), filter, &b.skipped);
+    }
+  };
+
+  int workers_needed = std::min(threads, (int)files.size());
+
+  if(workers_needed <= 1){
+    work();
+    return;
+  }
+
+  std::vector < std::thread > workers;
+
+  for(int t = 0; t < workers_needed; t++){
+    workers.push_back(std::thread(work));
+  }
+
+  for(size_t t = 0; t < workers.size(); t++){
+    workers[t].join();
+  }
+}
+
+// [[Rcpp::export]]
+
+DataFrame slx_read_many(CharacterVector paths, bool display_progress=true, bool read_frames=false, int threads=1,
+                        Nullable<IntegerVector> channels=R_NilValue, Nullable<NumericVector> time_range=R_NilValue,
+                        Nullable<NumericVector> bbox=R_NilValue) {
+
+  if(paths.size() == 0){
+    stop("At least one file is required");
+  }
+
+  PROFILE_RESET();
+
+  std::vector < std::unique_ptr < SlxBatchFile > > files;
+
+  for(R_xlen_t k = 0; k < paths.size(); k++){
+
+    std::string full_path = std::string(R_ExpandFileName(std::string(paths[k]).c_str()));
+
+    files.push_back(std::unique_ptr < SlxBatchFile >(new SlxBatchFile(full_path)));
+    SlxBatchFile& b = *files.back();
+
+    if(!b.file.is_open() || b.file.size() < FILE_HEADER_SIZE){
+      stop("Unable to open file: " + full_path);
+    }
+
+    const unsigned char *base = b.file.data();
+
+    b.format = read_le<uint16_t>(base);
+    b.version = read_le<uint16_t>(base + 2);
+    b.blockSize = read_le<uint16_t>(base + 4);
+
+    if(!known_format(b.format)){
+      stop("The file " + full_path + " appears to be neither '.sl2' or '.sl3'.");
+    }
+
+    PROFILE_COUNT(PROFILE_FILE_BYTES, b.file.size());
+  }
+
+  //First pass: offsets of the records passing the filter in every file
+  index_files(files, make_filter(channels, time_range, bbox), threads);
+
+  //The files are stacked in the order given, which fixes the rows and the part of the frame block of each
+  std::vector < size_t > row_starts;
+  size_t n = 0;
+
+  for(size_t k = 0; k < files.size(); k++){
+    files[k]->row_start = n;
+    row_starts.push_back(n);
+    n += files[k]->offsets.size();
+  }
+
+  SlxColumns cols(n);
+
+  RawVector frames;
+  NumericVector frame_offsets;
+
+  if(read_frames){
+
+    frame_offsets = NumericVector(no_init(n));
+
+    size_t frame_total = 0;
+
+    for(size_t k = 0; k < files.size(); k++){
+      SlxBatchFile& b = *files[k];
+      b.frame_start = frame_total;
+      frame_total += frame_layout(b.file.data(), b.format, b.offsets, frame_offsets.begin() + b.row_start);
+    }
+
+    frames = RawVector(no_init((R_xlen_t)frame_total));
+  }
+
+  unsigned char *frames_ptr = read_frames ? frames.begin() : NULL;
+  const double *frame_offsets_ptr = read_frames ? frame_offsets.begin() : NULL;
+
+  //Shifted copies of the columns let each file be decoded with its own offsets, they are made here since copying
+  //the R vectors is not allowed on the worker threads
+  std::vector < SlxColumns > views(files.size(), cols);
+
+  for(size_t k = 0; k < files.size(); k++){
+    views[k].shift_rows(files[k]->row_start);
+  }
+
+  //Second pass: records of all files are split evenly over the threads, a block of rows may run from the end of one
+  //file into the next
+  run_decoder([&](size_t begin, size_t end) {
+
+    size_t k = std::upper_bound(row_starts.begin(), row_starts.end(), begin) - row_starts.begin() - 1;
+
+    for(; begin < end; k++){
+
+      SlxBatchFile& b = *files[k];
+      size_t file_end = std::min(end, b.row_start + b.offsets.size());
+
+      prefetch_block(b.file, b.offsets, file_end - b.row_start);
+
+      decode_records(b.format, b.file.data(), b.file.size(), b.offsets, begin - b.row_start, file_end - b.row_start,
+                     views[k], read_frames ? frames_ptr + b.frame_start : NULL,
+                     read_frames ? frame_offsets_ptr + b.row_start : NULL);
+
+      begin = file_end;
+    }
+
+  }, n, threads, display_progress);
+
+  //Frame offsets were laid out per file, they are made relative to the combined block
+  if(read_frames){
+    for(size_t k = 0; k < files.size(); k++){
+      SlxBatchFile& b = *files[k];
+      for(size_t i = 0; i < b.offsets.size(); i++){
+        frame_offsets[b.row_start + i] += b.frame_start;
       }
-      
-      p.increment();
-      
-      i++;
-      
     }
-    
-  }else if(format == 3){
-    
-    while (!(in.tellg() == -1)) {
-      
-      std::streampos recStart = in.tellg();
-      
-      uint32_t PositionOfFirstByte;
-      in.seekg(recStart); in.seekg(0, std::ios_base::cur);
-      in.read((char *)&PositionOfFirstByte, sizeof(PositionOfFirstByte));
-      
-      PositionOfFirstByteV.push_back(PositionOfFirstByte);
-      
-      uint16_t TotalLength, PreviousLength, SurveyType;
-      in.seekg(recStart); in.seekg(8, std::ios_base::cur);
-      in.read((char *)&TotalLength, sizeof(TotalLength));
-      in.read((char *)&PreviousLength, sizeof(PreviousLength));
-      in.read((char *)&SurveyType, sizeof(SurveyType));
-      
-      TotalLengthV.push_back(TotalLength);
-      PreviousLengthV.push_back(PreviousLength);
-      SurveyTypeV.push_back(SurveyType);
-      
-      uint32_t NumberOfCampaignInThisType;
-      float MinRange, MaxRange;
-      in.seekg(recStart); in.seekg(16, std::ios_base::cur);
-      in.read((char *)&NumberOfCampaignInThisType, sizeof(NumberOfCampaignInThisType));
-      in.read((char *)&MinRange, sizeof(MinRange));
-      in.read((char *)&MaxRange, sizeof(MaxRange));
-      
-      NumberOfCampaignInThisTypeV.push_back(NumberOfCampaignInThisType);
-      MinRangeV.push_back(MinRange);
-      MaxRangeV.push_back(MaxRange);
-      
-      uint32_t HardwareTime, OriginalLengthOfEchoData;
-      float WaterDepth;
-      //uint16_t Frequency;
-      uint8_t Frequency;
-      
-      in.seekg(recStart); in.seekg(40, std::ios_base::cur);
-      in.read((char *)&HardwareTime, sizeof(HardwareTime));
-      in.read((char *)&OriginalLengthOfEchoData, sizeof(OriginalLengthOfEchoData));
-      in.read((char *)&WaterDepth, sizeof(WaterDepth));
-      in.read((char *)&Frequency, sizeof(Frequency));
-      
-      HardwareTimeV.push_back(HardwareTime);
-      OriginalLengthOfEchoDataV.push_back(OriginalLengthOfEchoData);
-      WaterDepthV.push_back(WaterDepth);
-      FrequencyV.push_back(Frequency);
-      
-      float GNSSSpeed, WaterTemperature;
-      uint32_t XLowrance, YLowrance;
-      float WaterSpeed, GNSSHeading, GNSSAltitude, MagneticHeading;
-      
-      in.seekg(recStart); in.seekg(84, std::ios_base::cur);
-      in.read((char *)&GNSSSpeed, sizeof(GNSSSpeed));
-      in.read((char *)&WaterTemperature, sizeof(WaterTemperature));
-      in.read((char *)&XLowrance, sizeof(XLowrance));
-      in.read((char *)&YLowrance, sizeof(YLowrance));
-      in.read((char *)&WaterSpeed, sizeof(WaterSpeed));
-      in.read((char *)&GNSSHeading, sizeof(GNSSHeading));
-      in.read((char *)&GNSSAltitude, sizeof(GNSSAltitude));
-      in.read((char *)&MagneticHeading, sizeof(MagneticHeading));
-      
-      GNSSSpeedV.push_back(GNSSSpeed);
-      WaterTemperatureV.push_back(WaterTemperature);
-      XLowranceV.push_back(XLowrance);
-      YLowranceV.push_back(YLowrance);
-      WaterSpeedV.push_back(WaterSpeed);
-      GNSSHeadingV.push_back(GNSSHeading);
-      GNSSAltitudeV.push_back(GNSSAltitude);
-      MagneticHeadingV.push_back(MagneticHeading);
-      
-      std::bitset<16> flags;
-      in.read((char *)&flags, sizeof(flags));
-      
-      headingValidV.push_back(flags.test(0));
-      altitudeValidV.push_back(flags.test(1));
-      gpsSpeedValidV.push_back(flags.test(9));
-      waterTempValidV.push_back(flags.test(10));
-      positionValidV.push_back(flags.test(12));
-      waterSpeedValidV.push_back(flags.test(14));
-      trackValidV.push_back(flags.test(15));
-      
-      uint32_t Milliseconds;
-      in.seekg(recStart); in.seekg(124, std::ios_base::cur);
-      in.read((char *)&Milliseconds, sizeof(Milliseconds));
-      
-      MillisecondsV.push_back(Milliseconds);
-      
-      in.seekg(recStart); 
-      in.seekg(TotalLength, std::ios_base::cur);
-      
-      if (i % 1000 == 0){
-        checkUserInterrupt();
+  }
+
+  DataFrame out = slx_dataframe(cols, files[0]->format, files[0]->version, files[0]->blockSize);
+
+  //The files may mix formats, so the file header values are kept per file rather than those of the first file
+  IntegerVector file_rows(no_init(files.size()));
+  CharacterVector file_format(files.size()), file_version(files.size()), file_blocksize(files.size());
+
+  for(size_t k = 0; k < files.size(); k++){
+    file_rows[k] = (int)files[k]->offsets.size();
+    file_format[k] = std::to_string(files[k]->format);
+    file_version[k] = std::to_string(files[k]->version);
+    file_blocksize[k] = std::to_string(files[k]->blockSize);
+  }
+
+  out.attr("file_rows") = file_rows;
+  out.attr("format") = file_format;
+  out.attr("version") = file_version;
+  out.attr("blocksize") = file_blocksize;
+
+  //Damaged ranges of all files, 'File' is the position of the file in 'paths'
+  std::vector < SlxSkipped > skipped;
+  std::vector < int > skipped_file;
+
+  for(size_t k = 0; k < files.size(); k++){
+    skipped.insert(skipped.end(), files[k]->skipped.begin(), files[k]->skipped.end());
+    skipped_file.insert(skipped_file.end(), files[k]->skipped.size(), (int)k + 1);
+  }
+
+  out.attr("skipped") = skipped_dataframe(skipped, &skipped_file);
+
+  if(read_frames){
+    PROFILE_COUNT(PROFILE_FRAME_BYTES, frames.size());
+    out.attr("frames") = frames;
+    out.attr("frame_offsets") = frame_offsets;
+  }
+
+  return(out);
+
+}
+
+// Records of one channel read by slx_read_channels, decoded into their own columns and frame matrix
+struct SlxChannel {
+
+  explicit SlxChannel(size_t n) : cols(n), frame_length(0), frames_ptr(NULL), frame_offsets_ptr(NULL) {}
+
+  SlxColumns cols;
+  std::vector < size_t > offsets;
+  size_t frame_length;
+  RawVector frames;
+  NumericVector frame_offsets;
+
+  //Taken on the main thread, the workers must not touch R objects
+  unsigned char *frames_ptr;
+  const double *frame_offsets_ptr;
+
+};
+
+// [[Rcpp::export]]
+
+List slx_read_channels(std::string path, bool display_progress=true, bool read_frames=false, int threads=1,
+                       Nullable<IntegerVector> channels=R_NilValue, Nullable<NumericVector> time_range=R_NilValue,
+                       Nullable<NumericVector> bbox=R_NilValue) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  PROFILE_RESET();
+
+  MappedFile file(full_path);
+
+  if(!file.is_open() || file.size() < FILE_HEADER_SIZE){
+    stop("Unable to open file: " + full_path);
+  }
+
+  const unsigned char *base = file.data();
+  const size_t size = file.size();
+
+  PROFILE_COUNT(PROFILE_FILE_BYTES, size);
+
+  uint16_t format = read_le<uint16_t>(base);
+  uint16_t version = read_le<uint16_t>(base + 2);
+  uint16_t blockSize = read_le<uint16_t>(base + 4);
+
+  if(!known_format(format)){
+    stop("The file appears to be neither '.sl2' or '.sl3'.");
+  }
+
+  SlxKeyFields f = key_fields(format);
+
+  std::vector < SlxSkipped > skipped;
+  std::vector < size_t > offsets = select_records(file, f, make_filter(channels, time_range, bbox), R_NilValue, skipped);
+
+  //Records are grouped by channel label in file order, channels outside the known ones share "Unknown".
+  //The longest frame of each channel sets the number of rows of its frame matrix
+  std::vector < std::vector < size_t > > grouped(SURVEY_TYPE_LEVELS);
+  std::vector < size_t > frame_length(SURVEY_TYPE_LEVELS, 0);
+
+  for(size_t i = 0; i < offsets.size(); i++){
+
+    const unsigned char *rec = base + offsets[i];
+
+    int level = survey_type_level(read_le<uint16_t>(rec + f.survey_type_at)) - 1;
+
+    grouped[level].push_back(offsets[i]);
+    frame_length[level] = std::max(frame_length[level], f.echo_length(rec));
+  }
+
+  std::vector < std::unique_ptr < SlxChannel > > out_channels;
+  std::vector < int > out_levels;
+  std::vector < size_t > row_starts;
+  size_t n = 0;
+
+  for(int level = 0; level < SURVEY_TYPE_LEVELS; level++){
+
+    if(grouped[level].empty()) continue;
+
+    size_t m = grouped[level].size();
+
+    out_channels.push_back(std::unique_ptr < SlxChannel >(new SlxChannel(m)));
+    SlxChannel& ch = *out_channels.back();
+
+    ch.offsets.swap(grouped[level]);
+    out_levels.push_back(level + 1);
+    row_starts.push_back(n);
+    n += m;
+
+    if(read_frames){
+
+      //Column-major with one column per record, shorter frames are padded with zeros
+      ch.frame_length = frame_length[level];
+      ch.frames = frame_matrix(ch.frame_length, m);
+      ch.frame_offsets = NumericVector(no_init(m));
+
+      for(size_t i = 0; i < m; i++){
+        ch.frame_offsets[i] = (double)(i * ch.frame_length);
       }
-      
-      p.increment();
-      
-      i++;
-      
+
+      ch.frames_ptr = ch.frames.begin();
+      ch.frame_offsets_ptr = ch.frame_offsets.begin();
+    }
+  }
+
+  //All channels are decoded in one pass over the records, split evenly over the threads
+  run_decoder([&](size_t begin, size_t end) {
+
+    size_t k = std::upper_bound(row_starts.begin(), row_starts.end(), begin) - row_starts.begin() - 1;
+
+    for(; begin < end; k++){
+
+      SlxChannel& ch = *out_channels[k];
+      size_t channel_end = std::min(end, row_starts[k] + ch.offsets.size());
+
+      prefetch_block(file, ch.offsets, channel_end - row_starts[k]);
+
+      decode_records(format, base, size, ch.offsets, begin - row_starts[k], channel_end - row_starts[k], ch.cols,
+                     ch.frames_ptr, ch.frame_offsets_ptr);
+
+      begin = channel_end;
+    }
+
+  }, n, threads, display_progress);
+
+  List out;
+  CharacterVector labels = survey_type_labels();
+
+  for(size_t k = 0; k < out_channels.size(); k++){
+
+    SlxChannel& ch = *out_channels[k];
+
+    DataFrame df = slx_dataframe(ch.cols, format, version, blockSize);
+
+    if(read_frames){
+      PROFILE_COUNT(PROFILE_FRAME_BYTES, ch.frames.size());
+      df.attr("frames") = ch.frames;
+      df.attr("frame_offsets") = ch.frame_offsets;
+    }
+
+    out.push_back(df, std::string(labels[out_levels[k] - 1]));
+  }
+
+  out.attr("skipped") = skipped_dataframe(skipped);
+
+  return(out);
+
+}
+
+// [[Rcpp::export]]
+
+RawVector slx_frame_matrix(RawVector frames, NumericVector frame_offsets, NumericVector frame_lengths) {
+
+  R_xlen_t n = frame_offsets.size();
+
+  if(frame_lengths.size() != n){
+    stop("Frame offsets and lengths must have one value per row");
+  }
+
+  size_t frame_length = 0;
+
+  for(R_xlen_t i = 0; i < n; i++){
+    if(frame_offsets[i] < 0 || frame_lengths[i] < 0 || frame_offsets[i] + frame_lengths[i] > frames.size()){
+      stop("Frame offset out of bounds for record " + std::to_string(i + 1));
     }
-    
-  }else{
-    
-    Rcout << "The file appears to be neither '.sl2' or '.sl3' - stopping." << std::endl;
-    
-    return(-1);
-    
-  }
-  
-  PositionOfFirstByteV.resize(PositionOfFirstByteV.size()-1);
-  TotalLengthV.resize(TotalLengthV.size()-1);
-  PreviousLengthV.resize(PreviousLengthV.size()-1);
-  SurveyTypeV.resize(SurveyTypeV.size()-1);
-  NumberOfCampaignInThisTypeV.resize(NumberOfCampaignInThisTypeV.size()-1);
-  MinRangeV.resize(MinRangeV.size()-1);
-  MaxRangeV.resize(MaxRangeV.size()-1);
-  HardwareTimeV.resize(HardwareTimeV.size()-1);
-  OriginalLengthOfEchoDataV.resize(OriginalLengthOfEchoDataV.size()-1);
-  WaterDepthV.resize(WaterDepthV.size()-1);
-  FrequencyV.resize(FrequencyV.size()-1);
-  GNSSSpeedV.resize(GNSSSpeedV.size()-1);
-  WaterTemperatureV.resize(WaterTemperatureV.size()-1);
-  XLowranceV.resize(XLowranceV.size()-1);
-  YLowranceV.resize(YLowranceV.size()-1);
-  WaterSpeedV.resize(WaterSpeedV.size()-1);
-  GNSSHeadingV.resize(GNSSHeadingV.size()-1);
-  GNSSAltitudeV.resize(GNSSAltitudeV.size()-1);
-  MagneticHeadingV.resize(MagneticHeadingV.size()-1);
-  headingValidV.resize(headingValidV.size()-1);
-  altitudeValidV.resize(altitudeValidV.size()-1);
-  gpsSpeedValidV.resize(gpsSpeedValidV.size()-1);
-  waterTempValidV.resize(waterTempValidV.size()-1);
-  positionValidV.resize(positionValidV.size()-1);
-  waterSpeedValidV.resize(waterSpeedValidV.size()-1);
-  trackValidV.resize(trackValidV.size()-1);
-  MillisecondsV.resize(MillisecondsV.size()-1);
-  
-  out = DataFrame::create(
-    _["PositionOfFirstByte"] = PositionOfFirstByteV,
-    _["TotalLength"] = TotalLengthV,
-    _["PreviousLength"] = PreviousLengthV,
-    _["SurveyType"] = SurveyTypeV,
-    _["NumberOfCampaignInThisType"] = NumberOfCampaignInThisTypeV,
-    _["MinRange"] = MinRangeV,
-    _["MaxRange"] = MaxRangeV,
-    _["HardwareTime"] = HardwareTimeV,
-    _["OriginalLengthOfEchoData"] = OriginalLengthOfEchoDataV,
-    _["WaterDepth"] = WaterDepthV,
-    _["Frequency"] = FrequencyV,
-    _["WaterTemperature"] = WaterTemperatureV,
-    _["XLowrance"] = XLowranceV,
-    _["YLowrance"] = YLowranceV,
-    _["WaterSpeed"] = WaterSpeedV,
-    _["MagneticHeading"] = MagneticHeadingV,
-    _["Milliseconds"] = MillisecondsV,
-    _["valid"] = List::create(
-      _["Heading"] = headingValidV,
-      _["Altitude"] = altitudeValidV,
-      _["GNSSSpeed"] = gpsSpeedValidV,
-      _["WaterTemperature"] = waterTempValidV,
-      _["Position"] = positionValidV,
-      _["WaterSpeed"] = waterSpeedValidV,
-      _["MagneticHeading"] = trackValidV
-    ),
-    _["GNSS"] = List::create(
-      _["Speed"] = GNSSSpeedV,
-      _["Heading"] = GNSSHeadingV,
-      _["Altitude"] = GNSSAltitudeV
-    ),
-    _["stringsAsFactors"] = false
-  );
-  
-  out.attr("class") = CharacterVector::create("data.frame");
-  out.attr("format") = CharacterVector::create(std::to_string(format));
-  out.attr("version") = CharacterVector::create(std::to_string(version));
-  out.attr("blocksize") = CharacterVector::create(std::to_string(blockSize));
-  
+    frame_length = std::max(frame_length, (size_t)frame_lengths[i]);
+  }
+
+  //Same layout as the frames of slx_read_channels, one column per record padded with zeros
+  RawVector out = frame_matrix(frame_length, n);
+
+  for(R_xlen_t i = 0; i < n; i++){
+    std::memcpy(out.begin() + i * frame_length, frames.begin() + (size_t)frame_offsets[i], (size_t)frame_lengths[i]);
+  }
+
   return(out);
-  
-}
\ No newline at end of file
+
+}
+
+// [[Rcpp::export]]
+
+SEXP slx_profile() {
+
+#ifdef SONAR_PROFILE
+
+  SlxProfile& p = slx_profile_state();
+
+  long minor_faults, major_faults;
+  SlxProfile::page_faults(minor_faults, major_faults);
+
+  NumericVector counters(no_init(PROFILE_COUNTERS + 2));
+
+  for(int i = 0; i < PROFILE_COUNTERS; i++){
+    counters[i] = (double)p.counters[i];
+  }
+
+  counters[PROFILE_COUNTERS] = (double)(minor_faults - p.minor_faults);
+  counters[PROFILE_COUNTERS + 1] = (double)(major_faults - p.major_faults);
+
+  counters.names() = CharacterVector::create("file_bytes", "records_scanned", "records_decoded", "header_bytes",
+                                             "frame_bytes", "reallocations", "prefetch_bytes", "minor_faults",
+                                             "major_faults");
+
+  NumericVector seconds(no_init(PROFILE_STAGES));
+
+  for(int i = 0; i < PROFILE_STAGES; i++){
+    seconds[i] = p.nanoseconds[i] / 1e9;
+  }
+
+  seconds.names() = CharacterVector::create("index", "layout", "decode", "dataframe");
+
+  return(List::create(_["counters"] = counters, _["seconds"] = seconds));
+
+#else
+
+  return(R_NilValue);
+
+#endif
+
+}
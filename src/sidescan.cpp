@@ -0,0 +1,256 @@
+// Georeferencing of sidescan pings, samples are placed on the ground and reduced straight into a grid
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include <limits>
+#include <thread>
+
+#include "sidescan.h"
+
+using namespace Rcpp;
+
+enum GridReducer { REDUCE_MAX, REDUCE_MIN, REDUCE_MEAN, REDUCE_COUNT };
+
+static SidescanPings make_pings(RawVector& frames, NumericVector& frame_offsets, NumericVector& lengths,
+                                NumericVector& x, NumericVector& y, NumericVector& heading,
+                                NumericVector& min_range, NumericVector& max_range, NumericVector& depth,
+                                bool slant_range) {
+
+  R_xlen_t n = frame_offsets.size();
+
+  if(lengths.size() != n || x.size() != n || y.size() != n || heading.size() != n ||
+     min_range.size() != n || max_range.size() != n || depth.size() != n){
+    stop("All record columns must have the same length");
+  }
+
+  for(R_xlen_t i = 0; i < n; i++){
+    if(frame_offsets[i] < 0 || lengths[i] < 0 || frame_offsets[i] + lengths[i] > frames.size()){
+      stop("Frame offset out of bounds for record " + std::to_string(i + 1));
+    }
+  }
+
+  SidescanPings p = {frames.begin(), frame_offsets.begin(), lengths.begin(), x.begin(), y.begin(), heading.begin(),
+                     min_range.begin(), max_range.begin(), depth.begin(), n, slant_range, NULL};
+
+  return(p);
+}
+
+static GridReducer parse_reducer(const std::string& fun) {
+  if(fun == "max") return(REDUCE_MAX);
+  if(fun == "min") return(REDUCE_MIN);
+  if(fun == "mean") return(REDUCE_MEAN);
+  if(fun == "count") return(REDUCE_COUNT);
+  stop("'fun' must be one of 'max', 'min', 'mean' or 'count'");
+}
+
+// Accumulates the samples falling in grid rows [row_begin, row_end), threads own disjoint row bands so no locking is needed
+struct GridAccumulator {
+
+  double xmin, ymax, res;
+  R_xlen_t nrow, ncol, row_begin, row_end;
+  GridReducer reducer;
+  double *values;
+  int *counts;
+
+  void operator()(double lon, double lat, double value) {
+
+    R_xlen_t row = std::min((R_xlen_t)((ymax - lat) / res), nrow - 1);
+    R_xlen_t col = std::min((R_xlen_t)((lon - xmin) / res), ncol - 1);
+
+    if(row < row_begin || row >= row_end || row < 0 || col < 0) return;
+
+    //Column-major like R matrices
+    R_xlen_t cell = col * nrow + row;
+
+    switch(reducer){
+      case REDUCE_MAX: if(counts[cell] == 0 || value > values[cell]) values[cell] = value; break;
+      case REDUCE_MIN: if(counts[cell] == 0 || value < values[cell]) values[cell] = value; break;
+      case REDUCE_MEAN: values[cell] += value; break;
+      case REDUCE_COUNT: break;
+    }
+
+    counts[cell]++;
+  }
+
+};
+
+// [[Rcpp::export]]
+
+NumericMatrix sidescan_grid(RawVector frames, NumericVector frame_offsets, NumericVector lengths,
+                            NumericVector x, NumericVector y, NumericVector heading,
+                            NumericVector min_range, NumericVector max_range, NumericVector depth,
+                            double res, std::string fun="max", bool slant_range=false, bool normalize=false,
+                            int threads=1) {
+
+  if(!(res > 0)){
+    stop("'res' must be positive");
+  }
+
+  GridReducer reducer = parse_reducer(fun);
+
+  SidescanPings p = make_pings(frames, frame_offsets, lengths, x, y, heading, min_range, max_range, depth, slant_range);
+
+  std::vector < double > means;
+
+  if(normalize){
+    means = sample_means(p);
+    p.sample_mean = means.empty() ? NULL : &means[0];
+  }
+
+  //Positions are monotonic along a ping, so the extent follows from the first and last sample of each
+  double xmin = R_PosInf, xmax = R_NegInf, ymin = R_PosInf, ymax = R_NegInf;
+
+  std::vector < double > ping_top(p.n, NA_REAL), ping_bottom(p.n, NA_REAL);
+
+  for(R_xlen_t i = 0; i < p.n; i++){
+
+    R_xlen_t length = (R_xlen_t)p.lengths[i];
+
+    if(length == 0) continue;
+
+    double cos_heading = std::cos(p.heading[i]);
+    double sin_heading = std::sin(p.heading[i]);
+
+    double d0 = sample_distance(p, i, 0, length);
+    double d1 = sample_distance(p, i, length - 1, length);
+
+    double lon0 = lowrance_to_lon(p.x[i] + d0 * cos_heading), lon1 = lowrance_to_lon(p.x[i] + d1 * cos_heading);
+    double lat0 = lowrance_to_lat(p.y[i] - d0 * sin_heading), lat1 = lowrance_to_lat(p.y[i] - d1 * sin_heading);
+
+    if(!std::isfinite(lon0) || !std::isfinite(lon1) || !std::isfinite(lat0) || !std::isfinite(lat1)) continue;
+
+    xmin = std::min(xmin, std::min(lon0, lon1));
+    xmax = std::max(xmax, std::max(lon0, lon1));
+    ymin = std::min(ymin, std::min(lat0, lat1));
+    ymax = std::max(ymax, std::max(lat0, lat1));
+
+    ping_top[i] = std::max(lat0, lat1);
+    ping_bottom[i] = std::min(lat0, lat1);
+  }
+
+  if(xmin > xmax){
+    stop("No sidescan samples to grid");
+  }
+
+  R_xlen_t ncol = std::max((R_xlen_t)std::ceil((xmax - xmin) / res), (R_xlen_t)1);
+  R_xlen_t nrow = std::max((R_xlen_t)std::ceil((ymax - ymin) / res), (R_xlen_t)1);
+
+  //The grid is anchored at the lower left corner, the upper and right edges are rounded out to whole cells
+  xmax = xmin + ncol * res;
+  ymax = ymin + nrow * res;
+
+  NumericMatrix out((int)nrow, (int)ncol);
+  std::vector < int > counts(nrow * ncol, 0);
+
+  GridAccumulator base_acc = {xmin, ymax, res, nrow, ncol, 0, nrow, reducer, out.begin(), &counts[0]};
+
+  //Each worker walks all pings but skips those entirely outside its band of rows
+  auto work = [&](R_xlen_t row_begin, R_xlen_t row_end) {
+
+    GridAccumulator acc = base_acc;
+    acc.row_begin = row_begin;
+    acc.row_end = row_end;
+
+    for(R_xlen_t i = 0; i < p.n; i++){
+
+      if(p.lengths[i] == 0 || !(ping_top[i] >= ping_bottom[i])) continue;
+
+      R_xlen_t first_row = (R_xlen_t)((ymax - ping_top[i]) / res);
+      R_xlen_t last_row = (R_xlen_t)((ymax - ping_bottom[i]) / res);
+
+      if(last_row < row_begin || first_row >= row_end) continue;
+
+      visit_samples(p, i, 0, (R_xlen_t)p.lengths[i], acc);
+    }
+  };
+
+  if(threads <= 1 || nrow < threads){
+    work(0, nrow);
+  }else{
+
+    std::vector < std::thread > workers;
+    R_xlen_t band = (nrow + threads - 1) / threads;
+
+    for(int t = 0; t < threads; t++){
+      R_xlen_t row_begin = std::min(t * band, nrow);
+      R_xlen_t row_end = std::min(row_begin + band, nrow);
+      workers.push_back(std::thread(work, row_begin, row_end));
+    }
+
+    for(size_t t = 0; t < workers.size(); t++){
+      workers[t].join();
+    }
+  }
+
+  double *values = out.begin();
+
+  for(R_xlen_t cell = 0; cell < nrow * ncol; cell++){
+    if(reducer == REDUCE_COUNT){
+      values[cell] = counts[cell];
+    }else if(counts[cell] == 0){
+      values[cell] = NA_REAL;
+    }else if(reducer == REDUCE_MEAN){
+      values[cell] /= counts[cell];
+    }
+  }
+
+  out.attr("extent") = NumericVector::create(xmin, xmax, ymin, ymax);
+
+  return(out);
+
+}
+
+struct PointCollector {
+
+  double *lon, *lat, *value;
+  R_xlen_t k;
+
+  void operator()(double x, double y, double z) {
+    lon[k] = x;
+    lat[k] = y;
+    value[k] = z;
+    k++;
+  }
+
+};
+
+// [[Rcpp::export]]
+
+DataFrame sidescan_points(RawVector frames, NumericVector frame_offsets, NumericVector lengths,
+                          NumericVector x, NumericVector y, NumericVector heading,
+                          NumericVector min_range, NumericVector max_range, NumericVector depth,
+                          bool slant_range=false, bool normalize=false) {
+
+  SidescanPings p = make_pings(frames, frame_offsets, lengths, x, y, heading, min_range, max_range, depth, slant_range);
+
+  std::vector < double > means;
+
+  if(normalize){
+    means = sample_means(p);
+    p.sample_mean = means.empty() ? NULL : &means[0];
+  }
+
+  R_xlen_t total = 0;
+  for(R_xlen_t i = 0; i < p.n; i++){
+    total += (R_xlen_t)p.lengths[i];
+  }
+
+  NumericVector lon(no_init(total)), lat(no_init(total)), z(no_init(total));
+
+  PointCollector collect = {lon.begin(), lat.begin(), z.begin(), 0};
+
+  for(R_xlen_t i = 0; i < p.n; i++){
+    visit_samples(p, i, 0, (R_xlen_t)p.lengths[i], collect);
+  }
+
+  //Samples of pings without a position are not placed, the columns are cut to the samples collected
+  if(collect.k < total){
+    lon = NumericVector(lon.begin(), lon.begin() + collect.k);
+    lat = NumericVector(lat.begin(), lat.begin() + collect.k);
+    z = NumericVector(z.begin(), z.begin() + collect.k);
+  }
+
+  return(DataFrame::create(_["x"] = lon, _["y"] = lat, _["z"] = z));
+
+}
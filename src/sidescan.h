@@ -0,0 +1,102 @@
+// Placement of sidescan samples on the ground, shared by the gridding and mosaic code
+// Kenneth Thorø Martinsen
+
+#ifndef SONAR_SIDESCAN_H
+#define SONAR_SIDESCAN_H
+
+#include <cmath>
+#include <vector>
+
+#include "slx_decode.h"
+
+// Sidescan records as raw column pointers, shared read-only by the worker threads
+struct SidescanPings {
+
+  const unsigned char *frames;
+  const double *offsets, *lengths, *x, *y, *heading, *min_range, *max_range, *depth;
+  R_xlen_t n;
+  bool slant_range;
+
+  //Mean intensity of each sample index across all pings, samples are divided by it when normalizing
+  const double *sample_mean;
+
+};
+
+// Distance from the boat of sample j, spaced evenly from MinRange to MaxRange (port side negative).
+// With slant range correction the water depth under the boat is added as the other leg of the triangle
+inline double sample_distance(const SidescanPings& p, R_xlen_t i, R_xlen_t j, R_xlen_t length) {
+
+  double d = p.min_range[i];
+
+  if(length > 1){
+    d += (p.max_range[i] - p.min_range[i]) * j / (length - 1);
+  }
+
+  if(p.slant_range){
+    d = std::sqrt(d * d + p.depth[i] * p.depth[i]) * ((d > 0) - (d < 0));
+  }
+
+  return(d);
+}
+
+// Calls visit(lon, lat, value) for samples [first, last) of ping i.
+// Heading trig is evaluated once per ping, the per-sample work is a multiply-add and the latitude projection
+template <typename Visitor>
+inline void visit_samples(const SidescanPings& p, R_xlen_t i, R_xlen_t first, R_xlen_t last, Visitor& visit) {
+
+  R_xlen_t length = (R_xlen_t)p.lengths[i];
+
+  const unsigned char *frame = p.frames + (R_xlen_t)p.offsets[i];
+
+  double cos_heading = std::cos(p.heading[i]);
+  double sin_heading = std::sin(p.heading[i]);
+
+  for(R_xlen_t j = first; j < last; j++){
+
+    double d = sample_distance(p, i, j, length);
+
+    double lon = lowrance_to_lon(p.x[i] + d * cos_heading);
+    double lat = lowrance_to_lat(p.y[i] - d * sin_heading);
+
+    //Pings without a valid position or heading cannot be placed
+    if(!std::isfinite(lon) || !std::isfinite(lat)) continue;
+
+    double value = frame[j];
+
+    if(p.sample_mean != NULL){
+      value /= p.sample_mean[j];
+    }
+
+    visit(lon, lat, value);
+  }
+}
+
+// Per sample index mean over the pings long enough to have that sample
+inline std::vector < double > sample_means(const SidescanPings& p) {
+
+  std::vector < double > sum, count;
+
+  for(R_xlen_t i = 0; i < p.n; i++){
+
+    R_xlen_t length = (R_xlen_t)p.lengths[i];
+    const unsigned char *frame = p.frames + (R_xlen_t)p.offsets[i];
+
+    if(length > (R_xlen_t)sum.size()){
+      sum.resize(length, 0);
+      count.resize(length, 0);
+    }
+
+    for(R_xlen_t j = 0; j < length; j++){
+      sum[j] += frame[j];
+      count[j]++;
+    }
+  }
+
+  for(size_t j = 0; j < sum.size(); j++){
+    sum[j] /= count[j];
+  }
+
+  return(sum);
+}
+
+#endif
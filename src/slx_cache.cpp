@@ -0,0 +1,428 @@
+// Columnar cache of decoded surveys, typed header columns and the packed frames in one file
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include <cstring>
+#include <fstream>
+
+#include <zlib.h>
+
+#include "slx_mmap.h"
+
+using namespace Rcpp;
+
+// Cache layout: fixed 24 byte header, a directory with one 64 byte entry per column and the column data
+//   0  char[8]  magic "SONARCOL"
+//   8  uint32   layout version
+//   12 uint32   number of columns
+//   16 uint64   number of rows
+//   24 entries  char[32] name, uint8 type, uint8 codec, uint16 + uint32 unused,
+//               uint64 position of the data, uint64 stored size, uint64 size once decompressed
+// Column data start on 8 byte boundaries so uncompressed columns are copied out of the mapping in one block.
+// Strings are stored one after another as a uint32 length and the bytes, NA as the length CACHE_NA_STRING
+#define CACHE_MAGIC "SONARCOL"
+#define CACHE_LAYOUT 1
+#define CACHE_HEADER_SIZE 24
+#define CACHE_ENTRY_SIZE 64
+#define CACHE_NAME_SIZE 32
+#define CACHE_NA_STRING 0xFFFFFFFF
+
+// zlib takes at most 4 GB per call, larger columns are streamed in pieces
+#define CACHE_ZLIB_BLOCK ((size_t)1 << 30)
+
+enum CacheType { CACHE_INTEGER = 1, CACHE_DOUBLE = 2, CACHE_LOGICAL = 3, CACHE_RAW = 4, CACHE_STRING = 5 };
+enum CacheCodec { CACHE_PLAIN = 0, CACHE_ZLIB = 1 };
+
+struct CacheEntry {
+
+  std::string name;
+  uint8_t type, codec;
+  uint64_t position, stored, size;
+
+};
+
+// Appends one column to the cache, deflating it on the way when compression is requested
+class ColumnSink {
+
+public:
+
+  ColumnSink(std::ofstream& out, bool compress) : out_(out), compress_(compress), stored_(0), size_(0) {
+    if(compress_){
+      std::memset(&zs_, 0, sizeof(zs_));
+      if(deflateInit(&zs_, Z_DEFAULT_COMPRESSION) != Z_OK){
+        stop("Unable to initialise compression");
+      }
+    }
+  }
+
+  void write(const unsigned char *p, size_t n) {
+
+    size_ += n;
+
+    if(!compress_){
+      out_.write((const char *)p, n);
+      stored_ += n;
+      return;
+    }
+
+    while(n > 0){
+      size_t block = std::min(n, CACHE_ZLIB_BLOCK);
+      zs_.next_in = (Bytef *)p;
+      zs_.avail_in = (uInt)block;
+      deflate_available(Z_NO_FLUSH);
+      p += block;
+      n -= block;
+    }
+  }
+
+  // Flushes the stream, returns the stored and decompressed sizes of the column
+  void finish(uint64_t& stored, uint64_t& size) {
+    if(compress_){
+      zs_.next_in = NULL;
+      zs_.avail_in = 0;
+      deflate_available(Z_FINISH);
+      deflateEnd(&zs_);
+    }
+    stored = stored_;
+    size = size_;
+  }
+
+private:
+
+  void deflate_available(int flush) {
+    unsigned char buffer[1 << 16];
+    int status;
+    do {
+      zs_.next_out = buffer;
+      zs_.avail_out = sizeof(buffer);
+      status = deflate(&zs_, flush);
+      size_t produced = sizeof(buffer) - zs_.avail_out;
+      out_.write((const char *)buffer, produced);
+      stored_ += produced;
+    } while(zs_.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+  }
+
+  std::ofstream& out_;
+  bool compress_;
+  z_stream zs_;
+  uint64_t stored_, size_;
+
+};
+
+static void pad_to_boundary(std::ofstream& out, uint64_t& position) {
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t pad = (8 - position % 8) % 8;
+  out.write(zeros, pad);
+  position += pad;
+}
+
+static bool inflate_column(const unsigned char *src, size_t stored, unsigned char *dest, size_t size) {
+
+  if(size == 0){
+    return(true);
+  }
+
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+
+  if(inflateInit(&zs) != Z_OK){
+    return(false);
+  }
+
+  const unsigned char *in = src, *in_end = src + stored;
+  unsigned char *out = dest, *out_end = dest + size;
+
+  int status;
+
+  do {
+    if(zs.avail_in == 0){
+      size_t block = std::min((size_t)(in_end - in), CACHE_ZLIB_BLOCK);
+      zs.next_in = (Bytef *)in;
+      zs.avail_in = (uInt)block;
+      in += block;
+    }
+    if(zs.avail_out == 0){
+      size_t block = std::min((size_t)(out_end - out), CACHE_ZLIB_BLOCK);
+      zs.next_out = out;
+      zs.avail_out = (uInt)block;
+      out += block;
+    }
+    status = inflate(&zs, Z_NO_FLUSH);
+  } while(status == Z_OK);
+
+  bool complete = status == Z_STREAM_END && out == out_end && zs.avail_out == 0;
+
+  inflateEnd(&zs);
+
+  return(complete);
+}
+
+// [[Rcpp::export]]
+
+void slx_cache_write(std::string path, List columns, Nullable<RawVector> frames=R_NilValue,
+                     Nullable<NumericVector> frame_offsets=R_NilValue, Nullable<NumericVector> frame_lengths=R_NilValue,
+                     bool compress=false) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  CharacterVector names = columns.names();
+
+  R_xlen_t n = columns.size() > 0 ? Rf_xlength(columns[0]) : 0;
+
+  std::vector < CacheEntry > entries;
+
+  for(R_xlen_t j = 0; j < columns.size(); j++){
+
+    SEXP column = columns[j];
+
+    CacheEntry e;
+    e.name = as < std::string >(names[j]);
+
+    switch(TYPEOF(column)){
+      case INTSXP: e.type = CACHE_INTEGER; break;
+      case REALSXP: e.type = CACHE_DOUBLE; break;
+      case LGLSXP: e.type = CACHE_LOGICAL; break;
+      case STRSXP: e.type = CACHE_STRING; break;
+      default: stop("Column '" + e.name + "' must be integer, numeric, logical or character");
+    }
+
+    if(e.name.size() >= CACHE_NAME_SIZE){
+      stop("Column name '" + e.name + "' is too long");
+    }
+
+    if(Rf_xlength(column) != n){
+      stop("All columns must have the same length");
+    }
+
+    entries.push_back(e);
+  }
+
+  bool has_frames = frames.isNotNull();
+
+  RawVector buffer;
+  NumericVector offsets, lengths;
+
+  if(has_frames){
+
+    buffer = RawVector(frames);
+    offsets = NumericVector(frame_offsets);
+    lengths = NumericVector(frame_lengths);
+
+    if(offsets.size() != n || lengths.size() != n){
+      stop("Frame offsets and lengths must have one value per row");
+    }
+
+    for(R_xlen_t i = 0; i < n; i++){
+      if(offsets[i] < 0 || lengths[i] < 0 || offsets[i] + lengths[i] > buffer.size()){
+        stop("Frame offset out of bounds for record " + std::to_string(i + 1));
+      }
+    }
+
+    CacheEntry e;
+    e.name = "Frame";
+    e.type = CACHE_RAW;
+    entries.push_back(e);
+  }
+
+  std::ofstream out(full_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if(!out){
+    stop("Unable to write file: " + full_path);
+  }
+
+  //The directory is written once the position and size of every column is known
+  uint64_t position = CACHE_HEADER_SIZE + entries.size() * CACHE_ENTRY_SIZE;
+  std::vector < char > directory(position, 0);
+  out.write(&directory[0], position);
+
+  for(size_t j = 0; j < entries.size(); j++){
+
+    CacheEntry& e = entries[j];
+
+    e.codec = compress ? CACHE_ZLIB : CACHE_PLAIN;
+    e.position = position;
+
+    ColumnSink sink(out, compress);
+
+    if(e.type == CACHE_RAW){
+      //Frames of the rows kept are packed back to back, the lengths follow from OriginalLengthOfEchoData
+      for(R_xlen_t i = 0; i < n; i++){
+        sink.write(buffer.begin() + (size_t)offsets[i], (size_t)lengths[i]);
+      }
+    }else{
+      //Columns are stored as R holds them in memory, logicals as 32 bit integers
+      if(e.type == CACHE_DOUBLE){
+        NumericVector column = columns[j];
+        sink.write((const unsigned char *)column.begin(), n * sizeof(double));
+      }else if(e.type == CACHE_INTEGER){
+        IntegerVector column = columns[j];
+        sink.write((const unsigned char *)column.begin(), n * sizeof(int));
+      }else if(e.type == CACHE_STRING){
+        CharacterVector column = columns[j];
+        for(R_xlen_t i = 0; i < n; i++){
+          SEXP s = STRING_ELT(column, i);
+          uint32_t length = s == NA_STRING ? CACHE_NA_STRING : (uint32_t)LENGTH(s);
+          sink.write((const unsigned char *)&length, sizeof(length));
+          if(s != NA_STRING){
+            sink.write((const unsigned char *)CHAR(s), length);
+          }
+        }
+      }else{
+        LogicalVector column = columns[j];
+        sink.write((const unsigned char *)column.begin(), n * sizeof(int));
+      }
+    }
+
+    sink.finish(e.stored, e.size);
+
+    position += e.stored;
+    pad_to_boundary(out, position);
+  }
+
+  uint32_t layout = CACHE_LAYOUT;
+  uint32_t ncol = (uint32_t)entries.size();
+  uint64_t nrow = (uint64_t)n;
+
+  std::memcpy(&directory[0], CACHE_MAGIC, 8);
+  std::memcpy(&directory[8], &layout, 4);
+  std::memcpy(&directory[12], &ncol, 4);
+  std::memcpy(&directory[16], &nrow, 8);
+
+  for(size_t j = 0; j < entries.size(); j++){
+    char *entry = &directory[CACHE_HEADER_SIZE + j * CACHE_ENTRY_SIZE];
+    std::memcpy(entry, entries[j].name.c_str(), entries[j].name.size());
+    std::memcpy(entry + 32, &entries[j].type, 1);
+    std::memcpy(entry + 33, &entries[j].codec, 1);
+    std::memcpy(entry + 40, &entries[j].position, 8);
+    std::memcpy(entry + 48, &entries[j].stored, 8);
+    std::memcpy(entry + 56, &entries[j].size, 8);
+  }
+
+  out.seekp(0);
+  out.write(&directory[0], directory.size());
+
+  if(!out.good()){
+    stop("Unable to write file: " + full_path);
+  }
+
+}
+
+// [[Rcpp::export]]
+
+List slx_cache_read(std::string path, Nullable<CharacterVector> columns=R_NilValue) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  MappedFile file(full_path);
+
+  if(!file.is_open() || file.size() < CACHE_HEADER_SIZE){
+    stop("Unable to open file: " + full_path);
+  }
+
+  const unsigned char *base = file.data();
+  const size_t size = file.size();
+
+  if(std::memcmp(base, CACHE_MAGIC, 8) != 0 || read_le<uint32_t>(base + 8) != CACHE_LAYOUT){
+    stop("The file is not a sonar cache: " + full_path);
+  }
+
+  uint32_t ncol = read_le<uint32_t>(base + 12);
+  uint64_t nrow = read_le<uint64_t>(base + 16);
+
+  if(CACHE_HEADER_SIZE + (size_t)ncol * CACHE_ENTRY_SIZE > size){
+    stop("The cache is truncated: " + full_path);
+  }
+
+  std::vector < std::string > wanted;
+
+  if(columns.isNotNull()){
+    wanted = as < std::vector < std::string > >(columns);
+  }
+
+  List out;
+
+  //Only the columns asked for are paged in from the mapping
+  for(uint32_t j = 0; j < ncol; j++){
+
+    const unsigned char *entry = base + CACHE_HEADER_SIZE + (size_t)j * CACHE_ENTRY_SIZE;
+
+    CacheEntry e;
+    e.name = std::string((const char *)entry, strnlen((const char *)entry, CACHE_NAME_SIZE));
+    e.type = entry[32];
+    e.codec = entry[33];
+    e.position = read_le<uint64_t>(entry + 40);
+    e.stored = read_le<uint64_t>(entry + 48);
+    e.size = read_le<uint64_t>(entry + 56);
+
+    if(!wanted.empty() && std::find(wanted.begin(), wanted.end(), e.name) == wanted.end()){
+      continue;
+    }
+
+    if(e.position + e.stored > size || (e.codec == CACHE_PLAIN && e.stored != e.size)){
+      stop("The cache is truncated: " + full_path);
+    }
+
+    size_t width = e.type == CACHE_DOUBLE ? sizeof(double) : (e.type == CACHE_RAW ? 1 : sizeof(int));
+
+    if(e.type != CACHE_RAW && e.type != CACHE_STRING && e.size != nrow * width){
+      stop("Column '" + e.name + "' has the wrong size in " + full_path);
+    }
+
+    RObject column;
+    unsigned char *dest;
+
+    //Strings are unpacked from a copy of the stored bytes
+    std::vector < unsigned char > strings;
+
+    switch(e.type){
+      case CACHE_INTEGER: { IntegerVector v(no_init((R_xlen_t)nrow)); dest = (unsigned char *)v.begin(); column = v; break; }
+      case CACHE_DOUBLE: { NumericVector v(no_init((R_xlen_t)nrow)); dest = (unsigned char *)v.begin(); column = v; break; }
+      case CACHE_LOGICAL: { LogicalVector v(no_init((R_xlen_t)nrow)); dest = (unsigned char *)v.begin(); column = v; break; }
+      case CACHE_RAW: { RawVector v(no_init((R_xlen_t)e.size)); dest = v.begin(); column = v; break; }
+      case CACHE_STRING: { strings.resize(e.size + 1); dest = &strings[0]; break; }
+      default: stop("Column '" + e.name + "' has an unknown type in " + full_path);
+    }
+
+    if(e.codec == CACHE_PLAIN){
+      std::memcpy(dest, base + e.position, e.size);
+    }else if(!inflate_column(base + e.position, e.stored, dest, e.size)){
+      stop("Column '" + e.name + "' could not be decompressed in " + full_path);
+    }
+
+    if(e.type == CACHE_STRING){
+
+      CharacterVector v((R_xlen_t)nrow);
+      size_t pos = 0;
+
+      for(uint64_t i = 0; i < nrow; i++){
+
+        if(pos + sizeof(uint32_t) > e.size){
+          stop("Column '" + e.name + "' has the wrong size in " + full_path);
+        }
+
+        uint32_t length = read_le<uint32_t>(&strings[pos]);
+        pos += sizeof(uint32_t);
+
+        if(length == CACHE_NA_STRING){
+          v[i] = NA_STRING;
+          continue;
+        }
+
+        if(pos + length > e.size){
+          stop("Column '" + e.name + "' has the wrong size in " + full_path);
+        }
+
+        v[i] = std::string((const char *)&strings[pos], length);
+        pos += length;
+      }
+
+      column = v;
+    }
+
+    out.push_back(column, e.name);
+  }
+
+  return(out);
+
+}
@@ -0,0 +1,435 @@
+// Decoding of '.sl2' and '.sl3' record headers and frames shared by the readers
+// Kenneth Thorø Martinsen
+
+#ifndef SONAR_SLX_DECODE_H
+#define SONAR_SLX_DECODE_H
+
+#include <Rcpp.h>
+
+#include <cmath>
+#include <cstring>
+
+#include "slx_format.h"
+
+using namespace Rcpp;
+
+// Conversions applied while decoding, ranges and depths are logged in feet, speeds in knots and positions in
+// Lowrance's spherical Mercator projection (+proj=merc +a=6356752.3142 +b=6356752.3142)
+#define FEET_PER_METRE 3.2808399
+#define KNOTS_PER_MS 1.94385
+#define POLAR_EARTH_RADIUS 6356752.3142
+
+inline double lowrance_to_lon(double x) {
+  return(x / POLAR_EARTH_RADIUS * (180 / M_PI));
+}
+
+inline double lowrance_to_lat(double y) {
+  return(((2 * std::atan(std::exp(y / POLAR_EARTH_RADIUS))) - (M_PI / 2)) * (180 / M_PI));
+}
+
+inline double lon_to_lowrance(double lon) {
+  return(lon * (M_PI / 180) * POLAR_EARTH_RADIUS);
+}
+
+inline double lat_to_lowrance(double lat) {
+  return(POLAR_EARTH_RADIUS * std::log(std::tan((M_PI / 4) + (lat * (M_PI / 180)) / 2)));
+}
+
+// SurveyType codes as 1-based factor codes, anything outside the known channels is "Unknown"
+#define SURVEY_TYPE_LEVELS 7
+
+inline int survey_type_level(int code) {
+  return((code >= 0 && code <= 5) ? code + 1 : SURVEY_TYPE_LEVELS);
+}
+
+inline CharacterVector survey_type_labels() {
+  return(CharacterVector::create("Primary", "Secondary", "Downscan", "LeftSidescan", "RightSidescan", "Sidescan", "Unknown"));
+}
+
+inline void as_survey_type_factor(IntegerVector& x) {
+  x.attr("levels") = survey_type_labels();
+  x.attr("class") = "factor";
+}
+
+// Header fields of all records, allocated once as the final R columns and filled in place by the decoders.
+// 8 and 16 bit fields and coordinates are stored as integers, unsigned 32 bit fields and floats as doubles and the bits of Flags as logicals.
+// Ranges, depths and speeds are in metres and m/s
+struct SlxColumns {
+
+  NumericVector PositionOfFirstByte;
+  IntegerVector TotalLength;
+  IntegerVector PreviousLength;
+  IntegerVector SurveyType;
+  IntegerVector SurveyTypeLabel;
+  NumericVector NumberOfCampaignInThisType;
+  NumericVector MinRange;
+  NumericVector MaxRange;
+  NumericVector HardwareTime;
+  NumericVector OriginalLengthOfEchoData;
+  NumericVector WaterDepth;
+  IntegerVector Frequency;
+  NumericVector GNSSSpeed;
+  NumericVector WaterTemperature;
+  IntegerVector XLowrance;
+  IntegerVector YLowrance;
+  NumericVector Longitude;
+  NumericVector Latitude;
+  NumericVector WaterSpeed;
+  NumericVector GNSSHeading;
+  NumericVector GNSSAltitude;
+  NumericVector MagneticHeading;
+  NumericVector Milliseconds;
+  LogicalVector HeadingValid;
+  LogicalVector AltitudeValid;
+  LogicalVector GNSSSpeedValid;
+  LogicalVector WaterTemperatureValid;
+  LogicalVector PositionValid;
+  LogicalVector WaterSpeedValid;
+  LogicalVector MagneticHeadingValid;
+
+  //Raw storage of the columns above, worker threads write through these and never touch the R API
+  double *PositionOfFirstByteV;
+  int *TotalLengthV;
+  int *PreviousLengthV;
+  int *SurveyTypeV;
+  int *SurveyTypeLabelV;
+  double *NumberOfCampaignInThisTypeV;
+  double *MinRangeV;
+  double *MaxRangeV;
+  double *HardwareTimeV;
+  double *OriginalLengthOfEchoDataV;
+  double *WaterDepthV;
+  int *FrequencyV;
+  double *GNSSSpeedV;
+  double *WaterTemperatureV;
+  int *XLowranceV;
+  int *YLowranceV;
+  double *LongitudeV;
+  double *LatitudeV;
+  double *WaterSpeedV;
+  double *GNSSHeadingV;
+  double *GNSSAltitudeV;
+  double *MagneticHeadingV;
+  double *MillisecondsV;
+  int *HeadingValidV;
+  int *AltitudeValidV;
+  int *GNSSSpeedValidV;
+  int *WaterTemperatureValidV;
+  int *PositionValidV;
+  int *WaterSpeedValidV;
+  int *MagneticHeadingValidV;
+
+  explicit SlxColumns(size_t n) :
+    PositionOfFirstByte(no_init(n)), TotalLength(no_init(n)), PreviousLength(no_init(n)),
+    SurveyType(no_init(n)), SurveyTypeLabel(no_init(n)), NumberOfCampaignInThisType(no_init(n)),
+    MinRange(no_init(n)), MaxRange(no_init(n)), HardwareTime(no_init(n)), OriginalLengthOfEchoData(no_init(n)),
+    WaterDepth(no_init(n)), Frequency(no_init(n)), GNSSSpeed(no_init(n)), WaterTemperature(no_init(n)),
+    XLowrance(no_init(n)), YLowrance(no_init(n)), Longitude(no_init(n)), Latitude(no_init(n)),
+    WaterSpeed(no_init(n)), GNSSHeading(no_init(n)), GNSSAltitude(no_init(n)), MagneticHeading(no_init(n)), Milliseconds(no_init(n)),
+    HeadingValid(no_init(n)), AltitudeValid(no_init(n)), GNSSSpeedValid(no_init(n)),
+    WaterTemperatureValid(no_init(n)), PositionValid(no_init(n)), WaterSpeedValid(no_init(n)),
+    MagneticHeadingValid(no_init(n)) {
+    PositionOfFirstByteV = PositionOfFirstByte.begin();
+    TotalLengthV = TotalLength.begin();
+    PreviousLengthV = PreviousLength.begin();
+    SurveyTypeV = SurveyType.begin();
+    SurveyTypeLabelV = SurveyTypeLabel.begin();
+    NumberOfCampaignInThisTypeV = NumberOfCampaignInThisType.begin();
+    MinRangeV = MinRange.begin();
+    MaxRangeV = MaxRange.begin();
+    HardwareTimeV = HardwareTime.begin();
+    OriginalLengthOfEchoDataV = OriginalLengthOfEchoData.begin();
+    WaterDepthV = WaterDepth.begin();
+    FrequencyV = Frequency.begin();
+    GNSSSpeedV = GNSSSpeed.begin();
+    WaterTemperatureV = WaterTemperature.begin();
+    XLowranceV = XLowrance.begin();
+    YLowranceV = YLowrance.begin();
+    LongitudeV = Longitude.begin();
+    LatitudeV = Latitude.begin();
+    WaterSpeedV = WaterSpeed.begin();
+    GNSSHeadingV = GNSSHeading.begin();
+    GNSSAltitudeV = GNSSAltitude.begin();
+    MagneticHeadingV = MagneticHeading.begin();
+    MillisecondsV = Milliseconds.begin();
+    HeadingValidV = HeadingValid.begin();
+    AltitudeValidV = AltitudeValid.begin();
+    GNSSSpeedValidV = GNSSSpeedValid.begin();
+    WaterTemperatureValidV = WaterTemperatureValid.begin();
+    PositionValidV = PositionValid.begin();
+    WaterSpeedValidV = WaterSpeedValid.begin();
+    MagneticHeadingValidV = MagneticHeadingValid.begin();
+
+    as_survey_type_factor(SurveyTypeLabel);
+  }
+
+  //Moves the raw pointers 'rows' rows down, a copy shifted like this decodes a slice of a larger table from row 0
+  void shift_rows(size_t rows) {
+    PositionOfFirstByteV += rows;
+    TotalLengthV += rows;
+    PreviousLengthV += rows;
+    SurveyTypeV += rows;
+    SurveyTypeLabelV += rows;
+    NumberOfCampaignInThisTypeV += rows;
+    MinRangeV += rows;
+    MaxRangeV += rows;
+    HardwareTimeV += rows;
+    OriginalLengthOfEchoDataV += rows;
+    WaterDepthV += rows;
+    FrequencyV += rows;
+    GNSSSpeedV += rows;
+    WaterTemperatureV += rows;
+    XLowranceV += rows;
+    YLowranceV += rows;
+    LongitudeV += rows;
+    LatitudeV += rows;
+    WaterSpeedV += rows;
+    GNSSHeadingV += rows;
+    GNSSAltitudeV += rows;
+    MagneticHeadingV += rows;
+    MillisecondsV += rows;
+    HeadingValidV += rows;
+    AltitudeValidV += rows;
+    GNSSSpeedValidV += rows;
+    WaterTemperatureValidV += rows;
+    PositionValidV += rows;
+    WaterSpeedValidV += rows;
+    MagneticHeadingValidV += rows;
+  }
+
+};
+
+// Copies the echo data following a record header, zero-filling whatever a truncated log is missing
+inline void copy_frame(const unsigned char *frame, const unsigned char *end, size_t length, unsigned char *dest) {
+
+  size_t available = frame < end ? (size_t)(end - frame) : 0;
+  size_t n = length < available ? length : available;
+
+  std::memcpy(dest, frame, n);
+  std::memset(dest + n, 0, length - n);
+}
+
+// Zero filled raw matrix holding 'n' frames of up to 'frame_length' samples, one column per record
+inline RawVector frame_matrix(size_t frame_length, size_t n) {
+  RawVector frames((R_xlen_t)(frame_length * n));
+  frames.attr("dim") = IntegerVector::create((int)frame_length, (int)n);
+  return(frames);
+}
+
+// Decodes records [begin, end) of 'offsets' into the same rows of 'cols', copying frames when 'frames' is given
+template <typename Layout>
+inline void decode_records(const unsigned char *base, size_t size, const std::vector < size_t >& offsets,
+                           size_t begin, size_t end, SlxColumns& cols,
+                           unsigned char *frames, const double *frame_offsets) {
+
+  typedef typename Layout::EchoLengthType EchoLengthType;
+
+  for(size_t i = begin; i < end; i++){
+
+    const unsigned char *rec = base + offsets[i];
+
+    cols.PositionOfFirstByteV[i] = read_le<uint32_t>(rec + Layout::PositionOfFirstByte);
+
+    cols.TotalLengthV[i] = read_le<uint16_t>(rec + Layout::TotalLength);
+    cols.PreviousLengthV[i] = read_le<uint16_t>(rec + Layout::PreviousLength);
+    cols.SurveyTypeV[i] = read_le<uint16_t>(rec + Layout::SurveyType);
+    cols.SurveyTypeLabelV[i] = survey_type_level(cols.SurveyTypeV[i]);
+
+    EchoLengthType OriginalLengthOfEchoData = read_le<EchoLengthType>(rec + Layout::OriginalLengthOfEchoData);
+    cols.OriginalLengthOfEchoDataV[i] = OriginalLengthOfEchoData;
+
+    cols.NumberOfCampaignInThisTypeV[i] = read_le<uint32_t>(rec + Layout::NumberOfCampaignInThisType);
+    cols.MinRangeV[i] = read_le<float>(rec + Layout::MinRange) / FEET_PER_METRE;
+    cols.MaxRangeV[i] = read_le<float>(rec + Layout::MaxRange) / FEET_PER_METRE;
+
+    //uint16_t Frequency;
+    cols.FrequencyV[i] = read_le<uint8_t>(rec + Layout::Frequency);
+
+    cols.HardwareTimeV[i] = read_le<uint32_t>(rec + Layout::HardwareTime);
+    cols.WaterDepthV[i] = read_le<float>(rec + Layout::WaterDepth) / FEET_PER_METRE;
+
+    cols.GNSSSpeedV[i] = read_le<float>(rec + Layout::GNSSSpeed) / KNOTS_PER_MS;
+    cols.WaterTemperatureV[i] = read_le<float>(rec + Layout::WaterTemperature);
+
+    //Coordinates are signed, west and south of the origin are negative
+    int32_t XLowrance = read_le<int32_t>(rec + Layout::XLowrance);
+    int32_t YLowrance = read_le<int32_t>(rec + Layout::YLowrance);
+    cols.XLowranceV[i] = XLowrance;
+    cols.YLowranceV[i] = YLowrance;
+    cols.LongitudeV[i] = lowrance_to_lon(XLowrance);
+    cols.LatitudeV[i] = lowrance_to_lat(YLowrance);
+
+    cols.WaterSpeedV[i] = read_le<float>(rec + Layout::WaterSpeed) / KNOTS_PER_MS;
+    cols.GNSSHeadingV[i] = read_le<float>(rec + Layout::GNSSHeading);
+    cols.GNSSAltitudeV[i] = read_le<float>(rec + Layout::GNSSAltitude) / FEET_PER_METRE;
+    cols.MagneticHeadingV[i] = read_le<float>(rec + Layout::MagneticHeading);
+
+    uint16_t Flags = read_le<uint16_t>(rec + Layout::Flags);
+    cols.HeadingValidV[i] = (Flags >> 0) & 1;
+    cols.AltitudeValidV[i] = (Flags >> 1) & 1;
+    cols.GNSSSpeedValidV[i] = (Flags >> 9) & 1;
+    cols.WaterTemperatureValidV[i] = (Flags >> 10) & 1;
+    cols.PositionValidV[i] = (Flags >> 12) & 1;
+    cols.WaterSpeedValidV[i] = (Flags >> 14) & 1;
+    cols.MagneticHeadingValidV[i] = (Flags >> 15) & 1;
+
+    cols.MillisecondsV[i] = read_le<uint32_t>(rec + Layout::Milliseconds);
+
+    if(frames != NULL){
+      copy_frame(rec + Layout::HeaderSize, base + size, OriginalLengthOfEchoData, frames + (size_t)frame_offsets[i]);
+    }
+  }
+}
+
+// Offsets of each frame in the packed frame block, written to 'frame_offsets' (one per record), returns the size of the block
+template <typename Layout>
+inline size_t frame_layout(const unsigned char *base, const std::vector < size_t >& offsets, double *frame_offsets) {
+
+  typedef typename Layout::EchoLengthType EchoLengthType;
+
+  size_t frame_pos = 0;
+
+  for(size_t i = 0; i < offsets.size(); i++){
+    frame_offsets[i] = frame_pos;
+    frame_pos += read_le<EchoLengthType>(base + offsets[i] + Layout::OriginalLengthOfEchoData);
+  }
+
+  return(frame_pos);
+}
+
+// Runtime entry points, the format is resolved once per call and the specialised loop does the work
+struct DecodeVisitor {
+
+  const unsigned char *base; size_t size; const std::vector < size_t > *offsets;
+  size_t begin, end; SlxColumns *cols; unsigned char *frames; const double *frame_offsets;
+
+  template <typename Layout>
+  void visit() { decode_records<Layout>(base, size, *offsets, begin, end, *cols, frames, frame_offsets); }
+
+};
+
+inline void decode_records(uint16_t format, const unsigned char *base, size_t size, const std::vector < size_t >& offsets,
+                           size_t begin, size_t end, SlxColumns& cols,
+                           unsigned char *frames, const double *frame_offsets) {
+  PROFILE_COUNT(PROFILE_RECORDS_DECODED, end - begin);
+  PROFILE_COUNT(PROFILE_HEADER_BYTES, (end - begin) * key_fields(format).header_size);
+  DecodeVisitor v = {base, size, &offsets, begin, end, &cols, frames, frame_offsets};
+  visit_layout(format, v);
+}
+
+struct FrameLayoutVisitor {
+
+  const unsigned char *base; const std::vector < size_t > *offsets; double *frame_offsets;
+  size_t total;
+
+  template <typename Layout>
+  void visit() { total = frame_layout<Layout>(base, *offsets, frame_offsets); }
+
+};
+
+inline size_t frame_layout(const unsigned char *base, uint16_t format, const std::vector < size_t >& offsets,
+                           double *frame_offsets) {
+  PROFILE_STAGE(PROFILE_LAYOUT);
+  FrameLayoutVisitor v = {base, &offsets, frame_offsets, 0};
+  visit_layout(format, v);
+  return(v.total);
+}
+
+// Channel codes, a HardwareTime range and a bounding box in Lowrance coordinates (xmin, ymin, xmax, ymax), each optional
+inline SlxFilter make_filter(Nullable<IntegerVector> channels, Nullable<NumericVector> time_range, Nullable<NumericVector> bbox) {
+
+  SlxFilter filter;
+
+  if(channels.isNotNull()){
+    IntegerVector ch(channels);
+    filter.channels.assign(ch.begin(), ch.end());
+  }
+
+  if(time_range.isNotNull()){
+    NumericVector tr(time_range);
+    if(tr.size() != 2) stop("'time_range' must have length 2");
+    filter.use_time = true;
+    filter.time_min = tr[0];
+    filter.time_max = tr[1];
+  }
+
+  if(bbox.isNotNull()){
+    NumericVector bb(bbox);
+    if(bb.size() != 4) stop("'bbox' must have length 4");
+    filter.use_bbox = true;
+    filter.x_min = bb[0];
+    filter.y_min = bb[1];
+    filter.x_max = bb[2];
+    filter.y_max = bb[3];
+  }
+
+  return(filter);
+}
+
+// Byte ranges skipped over damaged records, as offsets from the start of the log with 'End' exclusive.
+// 'file' optionally tells which log each range was found in
+inline DataFrame skipped_dataframe(const std::vector < SlxSkipped >& skipped, const std::vector < int > *file = NULL) {
+
+  NumericVector Start(no_init(skipped.size())), End(no_init(skipped.size()));
+
+  for(size_t i = 0; i < skipped.size(); i++){
+    Start[i] = skipped[i].begin;
+    End[i] = skipped[i].end;
+  }
+
+  if(file != NULL){
+    return(DataFrame::create(_["File"] = IntegerVector(file->begin(), file->end()), _["Start"] = Start, _["End"] = End));
+  }
+
+  return(DataFrame::create(_["Start"] = Start, _["End"] = End));
+}
+
+// Wraps decoded columns in the data.frame layout returned by read_slx.
+// Built column by column since the table is wider than DataFrame::create accepts
+inline DataFrame slx_dataframe(const SlxColumns& cols, uint16_t format, uint16_t version, uint16_t blockSize) {
+
+  PROFILE_STAGE(PROFILE_DATAFRAME);
+
+  List out;
+
+  out.push_back(cols.PositionOfFirstByte, "PositionOfFirstByte");
+  out.push_back(cols.TotalLength, "TotalLength");
+  out.push_back(cols.PreviousLength, "PreviousLength");
+  out.push_back(cols.SurveyType, "SurveyType");
+  out.push_back(cols.SurveyTypeLabel, "SurveyTypeLabel");
+  out.push_back(cols.NumberOfCampaignInThisType, "NumberOfCampaignInThisType");
+  out.push_back(cols.MinRange, "MinRange");
+  out.push_back(cols.MaxRange, "MaxRange");
+  out.push_back(cols.HardwareTime, "HardwareTime");
+  out.push_back(cols.OriginalLengthOfEchoData, "OriginalLengthOfEchoData");
+  out.push_back(cols.WaterDepth, "WaterDepth");
+  out.push_back(cols.Frequency, "Frequency");
+  out.push_back(cols.WaterTemperature, "WaterTemperature");
+  out.push_back(cols.XLowrance, "XLowrance");
+  out.push_back(cols.YLowrance, "YLowrance");
+  out.push_back(cols.Longitude, "Longitude");
+  out.push_back(cols.Latitude, "Latitude");
+  out.push_back(cols.WaterSpeed, "WaterSpeed");
+  out.push_back(cols.MagneticHeading, "MagneticHeading");
+  out.push_back(cols.Milliseconds, "Milliseconds");
+  out.push_back(cols.HeadingValid, "validHeading");
+  out.push_back(cols.AltitudeValid, "validAltitude");
+  out.push_back(cols.GNSSSpeedValid, "validGNSSSpeed");
+  out.push_back(cols.WaterTemperatureValid, "validWaterTemperature");
+  out.push_back(cols.PositionValid, "validPosition");
+  out.push_back(cols.WaterSpeedValid, "validWaterSpeed");
+  out.push_back(cols.MagneticHeadingValid, "validMagneticHeading");
+  out.push_back(cols.GNSSSpeed, "GNSSSpeed");
+  out.push_back(cols.GNSSHeading, "GNSSHeading");
+  out.push_back(cols.GNSSAltitude, "GNSSAltitude");
+
+  out.attr("row.names") = IntegerVector::create(NA_INTEGER, -(int)cols.PositionOfFirstByte.size());
+  out.attr("class") = CharacterVector::create("data.frame");
+  out.attr("format") = CharacterVector::create(std::to_string(format));
+  out.attr("version") = CharacterVector::create(std::to_string(version));
+  out.attr("blocksize") = CharacterVector::create(std::to_string(blockSize));
+
+  return(DataFrame(out));
+}
+
+#endif
@@ -0,0 +1,377 @@
+// Layout of the Lowrance '.sl2' and '.sl3' log formats shared by the readers
+// Kenneth Thorø Martinsen
+
+#ifndef SONAR_SLX_FORMAT_H
+#define SONAR_SLX_FORMAT_H
+
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "slx_mmap.h"
+#include "slx_profile.h"
+
+#define FILE_HEADER_SIZE 8
+
+// Record layouts, one descriptor per log format holding the byte offset of every header field.
+// The decoders are instantiated per descriptor, so each field is loaded from a fixed offset.
+// Supporting another format means adding a descriptor here and a case in visit_layout
+struct Sl2Layout {
+
+  typedef uint16_t EchoLengthType;
+
+  static constexpr uint16_t Format = 2;
+  static constexpr size_t HeaderSize = 144;
+
+  static constexpr size_t PositionOfFirstByte = 0;
+  static constexpr size_t TotalLength = 28;
+  static constexpr size_t PreviousLength = 30;
+  static constexpr size_t SurveyType = 32;
+  static constexpr size_t OriginalLengthOfEchoData = 34;
+  static constexpr size_t NumberOfCampaignInThisType = 36;
+  static constexpr size_t MinRange = 40;
+  static constexpr size_t MaxRange = 44;
+  static constexpr size_t Frequency = 53;
+  static constexpr size_t HardwareTime = 60;
+  static constexpr size_t WaterDepth = 64;
+  static constexpr size_t GNSSSpeed = 100;
+  static constexpr size_t WaterTemperature = 104;
+  static constexpr size_t XLowrance = 108;
+  static constexpr size_t YLowrance = 112;
+  static constexpr size_t WaterSpeed = 116;
+  static constexpr size_t GNSSHeading = 120;
+  static constexpr size_t GNSSAltitude = 124;
+  static constexpr size_t MagneticHeading = 128;
+  static constexpr size_t Flags = 132;
+  static constexpr size_t Milliseconds = 140;
+
+};
+
+struct Sl3Layout {
+
+  typedef uint32_t EchoLengthType;
+
+  static constexpr uint16_t Format = 3;
+  static constexpr size_t HeaderSize = 168;
+
+  static constexpr size_t PositionOfFirstByte = 0;
+  static constexpr size_t TotalLength = 8;
+  static constexpr size_t PreviousLength = 10;
+  static constexpr size_t SurveyType = 12;
+  static constexpr size_t NumberOfCampaignInThisType = 16;
+  static constexpr size_t MinRange = 20;
+  static constexpr size_t MaxRange = 24;
+  static constexpr size_t HardwareTime = 40;
+  static constexpr size_t OriginalLengthOfEchoData = 44;
+  static constexpr size_t WaterDepth = 48;
+  static constexpr size_t Frequency = 52;
+  static constexpr size_t GNSSSpeed = 84;
+  static constexpr size_t WaterTemperature = 88;
+  static constexpr size_t XLowrance = 92;
+  static constexpr size_t YLowrance = 96;
+  static constexpr size_t WaterSpeed = 100;
+  static constexpr size_t GNSSHeading = 104;
+  static constexpr size_t GNSSAltitude = 108;
+  static constexpr size_t MagneticHeading = 112;
+  static constexpr size_t Flags = 116;
+  static constexpr size_t Milliseconds = 124;
+
+};
+
+// Calls visitor.template visit<Layout>() with the descriptor of 'format', returns false for unknown formats
+template <typename Visitor>
+inline bool visit_layout(uint16_t format, Visitor& visitor) {
+  switch(format){
+    case Sl2Layout::Format: visitor.template visit<Sl2Layout>(); return(true);
+    case Sl3Layout::Format: visitor.template visit<Sl3Layout>(); return(true);
+    default: return(false);
+  }
+}
+
+// Positions of the header fields used to index and filter records
+struct SlxKeyFields {
+
+  size_t header_size, total_length_at, previous_length_at, survey_type_at, echo_length_at, echo_length_size,
+         max_range_at, time_at, x_at, y_at;
+
+  template <typename Layout>
+  void visit() {
+    header_size = Layout::HeaderSize;
+    total_length_at = Layout::TotalLength;
+    previous_length_at = Layout::PreviousLength;
+    survey_type_at = Layout::SurveyType;
+    echo_length_at = Layout::OriginalLengthOfEchoData;
+    echo_length_size = sizeof(typename Layout::EchoLengthType);
+    max_range_at = Layout::MaxRange;
+    time_at = Layout::HardwareTime;
+    x_at = Layout::XLowrance;
+    y_at = Layout::YLowrance;
+  }
+
+  size_t echo_length(const unsigned char *rec) const {
+    return(echo_length_size == 2 ? read_le<uint16_t>(rec + echo_length_at) : read_le<uint32_t>(rec + echo_length_at));
+  }
+
+};
+
+inline bool known_format(uint16_t format) {
+  SlxKeyFields f;
+  return(visit_layout(format, f));
+}
+
+inline SlxKeyFields key_fields(uint16_t format) {
+  SlxKeyFields f;
+  visit_layout(format, f);
+  return(f);
+}
+
+// Record predicates checked on the raw header, so rejected records are never decoded
+struct SlxFilter {
+
+  std::vector < int > channels;
+  bool use_time, use_bbox;
+  double time_min, time_max;
+  double x_min, x_max, y_min, y_max;
+
+  SlxFilter() : use_time(false), use_bbox(false), time_min(0), time_max(0),
+                x_min(0), x_max(0), y_min(0), y_max(0) {}
+
+  bool active() const { return !channels.empty() || use_time || use_bbox; }
+
+  bool matches(const unsigned char *rec, const SlxKeyFields& f) const {
+
+    if(!channels.empty()){
+      int SurveyType = read_le<uint16_t>(rec + f.survey_type_at);
+      if(std::find(channels.begin(), channels.end(), SurveyType) == channels.end()) return(false);
+    }
+
+    if(use_time){
+      double HardwareTime = read_le<uint32_t>(rec + f.time_at);
+      if(HardwareTime < time_min || HardwareTime > time_max) return(false);
+    }
+
+    //Lowrance coordinates are signed mercator metres
+    if(use_bbox){
+      double x = read_le<int32_t>(rec + f.x_at);
+      double y = read_le<int32_t>(rec + f.y_at);
+      if(x < x_min || x > x_max || y < y_min || y > y_max) return(false);
+    }
+
+    return(true);
+  }
+
+};
+
+// Highest SurveyType code written by the units, anything above it is taken as a damaged header
+#define SURVEY_TYPE_MAX 9
+
+// Logs are read ahead in windows of PREFETCH_WINDOW bytes, keeping PREFETCH_DEPTH windows in flight
+#define PREFETCH_WINDOW (8 << 20)
+#define PREFETCH_DEPTH 4
+
+// Byte range [begin, end) of a log that held no valid records and was skipped
+struct SlxSkipped {
+  size_t begin, end;
+};
+
+// Walks the TotalLength chain of a mapped log from 'pos'. Every record is checked against its neighbours before it
+// is accepted, where the chain breaks (power loss, a damaged sector) the scanner searches forward for the next valid
+// header and keeps the range it skipped, so the records after the damage are still read
+struct SlxScanner {
+
+  const unsigned char *base;
+  size_t size;
+  SlxKeyFields f;
+  SlxFilter filter;
+
+  //Next record to visit and the TotalLength of the record before it, 0 when not known
+  size_t pos;
+  uint16_t previous;
+
+  //Stop before a record that may not be fully written yet instead of treating the end of the mapping as the end of
+  //the log, for logs that are still being recorded
+  bool complete_only;
+
+  //Kernel readahead is requested ahead of 'pos' up to 'requested' when a mapping is given
+  const MappedFile *readahead;
+  size_t requested;
+
+  std::vector < SlxSkipped > skipped;
+
+  SlxScanner(const unsigned char *base, size_t size, const SlxKeyFields& f, const SlxFilter& filter, size_t pos) :
+    base(base), size(size), f(f), filter(filter), pos(pos), previous(0), complete_only(false), readahead(NULL),
+    requested(0) {}
+
+  uint16_t total_length(size_t at) const { return read_le<uint16_t>(base + at + f.total_length_at); }
+
+  uint16_t previous_length(size_t at) const { return read_le<uint16_t>(base + at + f.previous_length_at); }
+
+  // The header at 'at' on its own: it fits in the log, holds a channel the units write and covers at least itself
+  // and its echo data. SurveyType is tested first as it rejects nearly every misaligned position
+  bool plausible(size_t at) const {
+
+    if(at + f.header_size > size || read_le<uint16_t>(base + at + f.survey_type_at) > SURVEY_TYPE_MAX) return(false);
+
+    size_t TotalLength = total_length(at);
+
+    return(TotalLength >= f.header_size && f.echo_length(base + at) <= TotalLength - f.header_size);
+  }
+
+  // A plausible header whose successor points back at it. Only the last record of the log has no successor to check,
+  // it must fit in the log and is only taken on trust when 'at' was reached through the chain, never by 'resync'
+  bool linked_forward(size_t at, bool chained) const {
+
+    if(!plausible(at)) return(false);
+
+    size_t next = at + total_length(at);
+
+    if(next + f.header_size > size){
+      return(chained && next <= size);
+    }
+
+    return(plausible(next) && previous_length(next) == total_length(at));
+  }
+
+  // First position after 'from' holding a record that chains on to the next one, or 'size' if there is none
+  size_t resync(size_t from) const {
+
+    for(size_t at = from + 1; at + f.header_size <= size; at++){
+      if(linked_forward(at, false)) return(at);
+    }
+
+    return(size);
+  }
+
+  // Keeps [begin, end) as skipped, unless it is zero padding at the end of the log
+  void skip(size_t begin, size_t end) {
+
+    if(end == size && std::find_if(base + begin, base + end, [](unsigned char b) { return(b != 0); }) == base + end){
+      return;
+    }
+
+    SlxSkipped range = {begin, end};
+    skipped.push_back(range);
+  }
+
+  // Collects up to 'max_records' offsets of records accepted by the filter. 'pos' is left at the first record not
+  // visited, or at the end of the log
+  std::vector < size_t > scan(size_t max_records) {
+
+    std::vector < size_t > offsets;
+    offsets.reserve(std::min(max_records, (size - std::min(pos, size))/2000));
+
+    bool check = filter.active();
+
+    while (pos + f.header_size <= size && offsets.size() < max_records) {
+
+      if(readahead != NULL && pos + (size_t)PREFETCH_WINDOW * (PREFETCH_DEPTH - 1) >= requested){
+        PROFILE_COUNT(PROFILE_PREFETCH_BYTES, PREFETCH_WINDOW);
+        readahead->prefetch(requested, requested + PREFETCH_WINDOW);
+        requested += PREFETCH_WINDOW;
+      }
+
+      uint16_t TotalLength = total_length(pos);
+
+      //In a log that is still being recorded the last record may not be fully written yet, it is left for a later
+      //call and 'pos' keeps pointing at it
+      if(complete_only && pos + TotalLength > size){
+        break;
+      }
+
+      //When the record before is known the last record of the log is only trusted if it links back to it. Within one
+      //scan that always holds, it matters for the first record of a call continuing from an earlier one
+      bool backward = previous != 0 && plausible(pos) && previous_length(pos) == previous;
+      bool forward = linked_forward(pos, previous == 0 || backward);
+
+      if(!forward && !backward){
+
+        size_t next = resync(pos);
+
+        //Nothing valid follows yet, more of the log may still be written
+        if(next == size && complete_only){
+          break;
+        }
+
+        skip(pos, next);
+
+        pos = next;
+        previous = 0;
+        continue;
+      }
+
+      //Only the link back to the previous record holds, so this record is kept but its length is not trusted and the
+      //scan continues at the next header that chains on
+      size_t next = forward ? pos + TotalLength : resync(pos);
+
+      if(!forward && next == size && complete_only){
+        break;
+      }
+
+      PROFILE_COUNT(PROFILE_RECORDS_SCANNED, 1);
+
+      if(!check || filter.matches(base + pos, f)){
+        PROFILE_COUNT(PROFILE_REALLOCATIONS, offsets.size() == offsets.capacity());
+        offsets.push_back(pos);
+      }
+
+      if(!forward && next > pos + TotalLength){
+        skip(pos + TotalLength, next);
+      }
+
+      previous = forward ? TotalLength : 0;
+      pos = next;
+    }
+
+    return(offsets);
+  }
+
+};
+
+// Follows the TotalLength chain from 'recStart' and collects up to 'max_records' offsets of records accepted
+// by the filter. 'recStart' is left at the first record not visited, or at the end of the log.
+// With 'complete_only' the scan stops before a record that extends past the end of the mapping. Ranges skipped
+// over damaged records are added to 'skipped' when given
+inline std::vector < size_t > scan_records(const unsigned char *base, size_t size, const SlxKeyFields& f,
+                                           const SlxFilter& filter, size_t& recStart, size_t max_records,
+                                           bool complete_only = false, std::vector < SlxSkipped > *skipped = NULL) {
+  SlxScanner scanner(base, size, f, filter, recStart);
+  scanner.complete_only = complete_only;
+
+  std::vector < size_t > offsets = scanner.scan(max_records);
+  recStart = scanner.pos;
+
+  if(skipped != NULL){
+    skipped->insert(skipped->end(), scanner.skipped.begin(), scanner.skipped.end());
+  }
+
+  return(offsets);
+}
+
+// Walks the TotalLength chain once and records where each record accepted by the filter starts
+inline std::vector < size_t > index_records(const unsigned char *base, size_t size, const SlxKeyFields& f,
+                                            const SlxFilter& filter = SlxFilter()) {
+  size_t recStart = FILE_HEADER_SIZE;
+  return(scan_records(base, size, f, filter, recStart, (size_t)-1));
+}
+
+// Same as index_records, but the kernel reads the log in large windows ahead of the scan. On slow or networked
+// storage the scan then waits for large sequential reads rather than for each page. Ranges skipped over damaged
+// records are added to 'skipped' when given
+inline std::vector < size_t > index_records_ahead(const MappedFile& file, const SlxKeyFields& f,
+                                                  const SlxFilter& filter = SlxFilter(),
+                                                  std::vector < SlxSkipped > *skipped = NULL) {
+
+  SlxScanner scanner(file.data(), file.size(), f, filter, FILE_HEADER_SIZE);
+  scanner.readahead = &file;
+
+  std::vector < size_t > offsets = scanner.scan((size_t)-1);
+
+  if(skipped != NULL){
+    skipped->insert(skipped->end(), scanner.skipped.begin(), scanner.skipped.end());
+  }
+
+  return(offsets);
+}
+
+#endif
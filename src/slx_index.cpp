@@ -0,0 +1,335 @@
+// Persistent record index stored next to a sonar log
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "slx_decode.h"
+
+using namespace Rcpp;
+
+// Sidecar layout: fixed 48 byte header followed by one array per indexed field
+//   0  char[8]  magic "SONARIDX"
+//   8  uint32   layout version
+//   12 uint16   log format, log version, log blocksize, unused
+//   20 uint32   number of skipped ranges
+//   24 uint64   size of the log when indexed
+//   32 int64    modification time of the log when indexed, in nanoseconds where the system records them
+//   40 uint64   number of records
+//   48 uint64[n] record offsets, uint32[n] HardwareTime, float[n] MaxRange,
+//      int32[n] XLowrance, int32[n] YLowrance, uint16[n] SurveyType,
+//      uint64[k] start and uint64[k] end of the ranges skipped over damaged records
+// Layout 2 holds the offsets of the validating scanner, layout 3 the modification time in nanoseconds.
+// Sidecars written before either are rebuilt
+#define INDEX_MAGIC "SONARIDX"
+#define INDEX_LAYOUT 3
+#define INDEX_HEADER_SIZE 48
+
+struct SlxIndex {
+
+  uint16_t format, version, blockSize;
+
+  std::vector < uint64_t > OffsetV;
+  std::vector < uint32_t > HardwareTimeV;
+  std::vector < float > MaxRangeV;
+  std::vector < int32_t > XLowranceV;
+  std::vector < int32_t > YLowranceV;
+  std::vector < uint16_t > SurveyTypeV;
+
+  std::vector < SlxSkipped > skipped;
+
+};
+
+static bool source_key(const std::string& path, uint64_t& size, int64_t& mtime) {
+
+#ifdef _WIN32
+  struct _stati64 st;
+
+  if(_stati64(path.c_str(), &st) != 0){
+    return(false);
+  }
+#else
+  struct stat st;
+
+  if(stat(path.c_str(), &st) != 0){
+    return(false);
+  }
+#endif
+
+  size = (uint64_t)st.st_size;
+
+  //A log rewritten within the same second keeps its size often enough, so whole seconds are not a safe key
+#if defined(__APPLE__)
+  mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  mtime = (int64_t)st.st_mtime * 1000000000;
+#else
+  mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+
+  return(true);
+}
+
+template <typename T>
+static void write_column(std::ofstream& out, const std::vector < T >& column) {
+  if(!column.empty()){
+    out.write((const char *)&column[0], column.size() * sizeof(T));
+  }
+}
+
+template <typename T>
+static const unsigned char* read_column(const unsigned char *p, size_t n, std::vector < T >& column) {
+  column.resize(n);
+  if(n > 0){
+    std::memcpy(&column[0], p, n * sizeof(T));
+  }
+  return(p + n * sizeof(T));
+}
+
+static SlxIndex build_index(const std::string& path) {
+
+  MappedFile file(path);
+
+  if(!file.is_open() || file.size() < FILE_HEADER_SIZE){
+    stop("Unable to open file: " + path);
+  }
+
+  const unsigned char *base = file.data();
+
+  SlxIndex idx;
+  idx.format = read_le<uint16_t>(base);
+  idx.version = read_le<uint16_t>(base + 2);
+  idx.blockSize = read_le<uint16_t>(base + 4);
+
+  if(!known_format(idx.format)){
+    stop("The file appears to be neither '.sl2' or '.sl3'.");
+  }
+
+  SlxKeyFields f = key_fields(idx.format);
+
+  std::vector < size_t > offsets = index_records_ahead(file, f, SlxFilter(), &idx.skipped);
+  size_t n = offsets.size();
+
+  idx.OffsetV.resize(n);
+  idx.HardwareTimeV.resize(n);
+  idx.MaxRangeV.resize(n);
+  idx.XLowranceV.resize(n);
+  idx.YLowranceV.resize(n);
+  idx.SurveyTypeV.resize(n);
+
+  for(size_t i = 0; i < n; i++){
+
+    const unsigned char *rec = base + offsets[i];
+
+    idx.OffsetV[i] = offsets[i];
+    idx.SurveyTypeV[i] = read_le<uint16_t>(rec + f.survey_type_at);
+    idx.MaxRangeV[i] = read_le<float>(rec + f.max_range_at);
+    idx.HardwareTimeV[i] = read_le<uint32_t>(rec + f.time_at);
+    idx.XLowranceV[i] = read_le<int32_t>(rec + f.x_at);
+    idx.YLowranceV[i] = read_le<int32_t>(rec + f.y_at);
+  }
+
+  return(idx);
+}
+
+static bool write_index_file(const std::string& sidecar, const SlxIndex& idx, uint64_t source_size, int64_t source_mtime) {
+
+  std::ofstream out(sidecar.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if(!out){
+    return(false);
+  }
+
+  unsigned char header[INDEX_HEADER_SIZE];
+  std::memset(header, 0, INDEX_HEADER_SIZE);
+
+  uint32_t layout = INDEX_LAYOUT;
+  uint32_t k = idx.skipped.size();
+  uint64_t n = idx.OffsetV.size();
+
+  std::memcpy(header, INDEX_MAGIC, 8);
+  std::memcpy(header + 8, &layout, 4);
+  std::memcpy(header + 12, &idx.format, 2);
+  std::memcpy(header + 14, &idx.version, 2);
+  std::memcpy(header + 16, &idx.blockSize, 2);
+  std::memcpy(header + 20, &k, 4);
+  std::memcpy(header + 24, &source_size, 8);
+  std::memcpy(header + 32, &source_mtime, 8);
+  std::memcpy(header + 40, &n, 8);
+
+  out.write((const char *)header, INDEX_HEADER_SIZE);
+
+  write_column(out, idx.OffsetV);
+  write_column(out, idx.HardwareTimeV);
+  write_column(out, idx.MaxRangeV);
+  write_column(out, idx.XLowranceV);
+  write_column(out, idx.YLowranceV);
+  write_column(out, idx.SurveyTypeV);
+
+  std::vector < uint64_t > SkippedStartV(k), SkippedEndV(k);
+
+  for(uint32_t i = 0; i < k; i++){
+    SkippedStartV[i] = idx.skipped[i].begin;
+    SkippedEndV[i] = idx.skipped[i].end;
+  }
+
+  write_column(out, SkippedStartV);
+  write_column(out, SkippedEndV);
+
+  out.close();
+
+  return(!out.fail());
+}
+
+// The sidecar is written under a temporary name and renamed over the old one, so an interrupted write or another
+// session indexing the same log never leaves a truncated sidecar behind
+static bool write_index(const std::string& sidecar, const SlxIndex& idx, uint64_t source_size, int64_t source_mtime) {
+
+  std::string temporary = sidecar + ".tmp" + std::to_string((long)getpid());
+
+  if(!write_index_file(temporary, idx, source_size, source_mtime)){
+    std::remove(temporary.c_str());
+    return(false);
+  }
+
+#ifdef _WIN32
+  //rename does not replace an existing file on Windows
+  std::remove(sidecar.c_str());
+#endif
+
+  if(std::rename(temporary.c_str(), sidecar.c_str()) != 0){
+    std::remove(temporary.c_str());
+    return(false);
+  }
+
+  return(true);
+}
+
+// Loads the sidecar if it exists and was written for the current size and mtime of the log
+static bool load_index(const std::string& sidecar, SlxIndex& idx, uint64_t source_size, int64_t source_mtime) {
+
+  MappedFile file(sidecar);
+
+  if(!file.is_open() || file.size() < INDEX_HEADER_SIZE){
+    return(false);
+  }
+
+  const unsigned char *p = file.data();
+
+  if(std::memcmp(p, INDEX_MAGIC, 8) != 0 ||
+     read_le<uint32_t>(p + 8) != INDEX_LAYOUT ||
+     read_le<uint64_t>(p + 24) != source_size ||
+     read_le<int64_t>(p + 32) != source_mtime){
+    return(false);
+  }
+
+  idx.format = read_le<uint16_t>(p + 12);
+  idx.version = read_le<uint16_t>(p + 14);
+  idx.blockSize = read_le<uint16_t>(p + 16);
+
+  uint32_t k = read_le<uint32_t>(p + 20);
+  uint64_t n = read_le<uint64_t>(p + 40);
+
+  size_t record_bytes = sizeof(uint64_t) + 4 * sizeof(uint32_t) + sizeof(uint16_t);
+  size_t skipped_bytes = 2 * sizeof(uint64_t);
+  size_t available = file.size() - INDEX_HEADER_SIZE;
+
+  //The counts come from the file, they are bounded by its size before being multiplied so they cannot wrap around
+  if(n > available / record_bytes || k > (available - n * record_bytes) / skipped_bytes ||
+     available != n * record_bytes + k * skipped_bytes){
+    return(false);
+  }
+
+  p += INDEX_HEADER_SIZE;
+  p = read_column(p, n, idx.OffsetV);
+  p = read_column(p, n, idx.HardwareTimeV);
+  p = read_column(p, n, idx.MaxRangeV);
+  p = read_column(p, n, idx.XLowranceV);
+  p = read_column(p, n, idx.YLowranceV);
+  p = read_column(p, n, idx.SurveyTypeV);
+
+  std::vector < uint64_t > SkippedStartV, SkippedEndV;
+  p = read_column(p, k, SkippedStartV);
+  p = read_column(p, k, SkippedEndV);
+
+  idx.skipped.resize(k);
+
+  for(uint32_t i = 0; i < k; i++){
+    idx.skipped[i].begin = SkippedStartV[i];
+    idx.skipped[i].end = SkippedEndV[i];
+  }
+
+  return(true);
+}
+
+// [[Rcpp::export]]
+
+DataFrame slx_index(std::string path, std::string sidecar, bool rebuild=false, bool write=true) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+  std::string full_sidecar = std::string(R_ExpandFileName(sidecar.c_str()));
+
+  uint64_t source_size;
+  int64_t source_mtime;
+
+  if(!source_key(full_path, source_size, source_mtime)){
+    stop("Unable to open file: " + full_path);
+  }
+
+  SlxIndex idx;
+
+  if(rebuild || !load_index(full_sidecar, idx, source_size, source_mtime)){
+
+    idx = build_index(full_path);
+
+    if(write && !write_index(full_sidecar, idx, source_size, source_mtime)){
+      warning("Unable to write index file: " + full_sidecar);
+    }
+  }
+
+  size_t n = idx.OffsetV.size();
+
+  IntegerVector SurveyTypeLabel(no_init(n));
+  NumericVector MaxRange(no_init(n)), Longitude(no_init(n)), Latitude(no_init(n));
+
+  for(size_t i = 0; i < n; i++){
+    SurveyTypeLabel[i] = survey_type_level(idx.SurveyTypeV[i]);
+    MaxRange[i] = idx.MaxRangeV[i] / FEET_PER_METRE;
+    Longitude[i] = lowrance_to_lon(idx.XLowranceV[i]);
+    Latitude[i] = lowrance_to_lat(idx.YLowranceV[i]);
+  }
+
+  as_survey_type_factor(SurveyTypeLabel);
+
+  DataFrame out = DataFrame::create(
+    _["Offset"] = NumericVector(idx.OffsetV.begin(), idx.OffsetV.end()),
+    _["SurveyType"] = IntegerVector(idx.SurveyTypeV.begin(), idx.SurveyTypeV.end()),
+    _["SurveyTypeLabel"] = SurveyTypeLabel,
+    _["HardwareTime"] = NumericVector(idx.HardwareTimeV.begin(), idx.HardwareTimeV.end()),
+    _["MaxRange"] = MaxRange,
+    _["XLowrance"] = IntegerVector(idx.XLowranceV.begin(), idx.XLowranceV.end()),
+    _["YLowrance"] = IntegerVector(idx.YLowranceV.begin(), idx.YLowranceV.end()),
+    _["Longitude"] = Longitude,
+    _["Latitude"] = Latitude,
+    _["stringsAsFactors"] = false
+  );
+
+  out.attr("format") = CharacterVector::create(std::to_string(idx.format));
+  out.attr("version") = CharacterVector::create(std::to_string(idx.version));
+  out.attr("blocksize") = CharacterVector::create(std::to_string(idx.blockSize));
+  out.attr("skipped") = skipped_dataframe(idx.skipped);
+
+  return(out);
+
+}
@@ -0,0 +1,102 @@
+// Lazy access to sonar logs, records are decoded from the mapped file only when they are looked at
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include "slx_decode.h"
+
+using namespace Rcpp;
+
+// Log mapped for the lifetime of a lazy 'sonar' object, kept alive on the R side through an external pointer
+struct SlxLazy {
+
+  explicit SlxLazy(const std::string& path) : file(path) {}
+
+  MappedFile file;
+  uint16_t format, version, blockSize;
+  SlxKeyFields f;
+
+};
+
+// [[Rcpp::export]]
+
+SEXP slx_lazy_open(std::string path) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  XPtr<SlxLazy> lazy(new SlxLazy(full_path), true);
+
+  if(!lazy->file.is_open() || lazy->file.size() < FILE_HEADER_SIZE){
+    stop("Unable to open file: " + full_path);
+  }
+
+  const unsigned char *base = lazy->file.data();
+
+  lazy->format = read_le<uint16_t>(base);
+  lazy->version = read_le<uint16_t>(base + 2);
+  lazy->blockSize = read_le<uint16_t>(base + 4);
+
+  if(!known_format(lazy->format)){
+    stop("The file appears to be neither '.sl2' or '.sl3'.");
+  }
+
+  lazy->f = key_fields(lazy->format);
+
+  //Browsing jumps around the log, so no read-ahead beyond the pages that are touched
+  lazy->file.random_access();
+
+  return(lazy);
+
+}
+
+// [[Rcpp::export]]
+
+DataFrame slx_lazy_read(SEXP lazy, NumericVector record_offsets, bool read_frames=false) {
+
+  XPtr<SlxLazy> l(lazy);
+
+  //Handles do not survive saveRDS or a new session, the mapping has to be opened again
+  if(l.get() == NULL){
+    stop("The lazy 'sonar' object is no longer valid, reopen the file with sonar_lazy()");
+  }
+
+  const unsigned char *base = l->file.data();
+  const size_t size = l->file.size();
+
+  size_t n = record_offsets.size();
+
+  std::vector < size_t > offsets(n);
+
+  for(size_t i = 0; i < n; i++){
+    if(!(record_offsets[i] >= FILE_HEADER_SIZE && record_offsets[i] + l->f.header_size <= size)){
+      stop("Record offset " + std::to_string((long long)record_offsets[i]) + " is outside the file");
+    }
+    offsets[i] = (size_t)record_offsets[i];
+  }
+
+  //Only the headers (and frames) of the requested records are touched
+  SlxColumns cols(n);
+
+  RawVector frames;
+  NumericVector frame_offsets;
+
+  if(read_frames){
+    frame_offsets = NumericVector(no_init(n));
+    frames = RawVector(no_init((R_xlen_t)frame_layout(base, l->format, offsets, frame_offsets.begin())));
+  }
+
+  unsigned char *frames_ptr = read_frames ? frames.begin() : NULL;
+  const double *frame_offsets_ptr = read_frames ? frame_offsets.begin() : NULL;
+
+  decode_records(l->format, base, size, offsets, 0, n, cols, frames_ptr, frame_offsets_ptr);
+
+  DataFrame out = slx_dataframe(cols, l->format, l->version, l->blockSize);
+
+  if(read_frames){
+    out.attr("frames") = frames;
+    out.attr("frame_offsets") = frame_offsets;
+  }
+
+  return(out);
+
+}
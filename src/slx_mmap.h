@@ -0,0 +1,149 @@
+// Read-only memory mapping of sonar log files
+// Kenneth Thorø Martinsen
+
+#ifndef SONAR_SLX_MMAP_H
+#define SONAR_SLX_MMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Maps a whole file into memory so record headers can be decoded straight from the mapped bytes
+class MappedFile {
+
+public:
+
+  explicit MappedFile(const std::string& path) : data_(NULL), size_(0) {
+
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    mapping_ = NULL;
+    if(file_ == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER filesize;
+    if(!GetFileSizeEx(file_, &filesize) || filesize.QuadPart == 0) return;
+    size_ = (size_t)filesize.QuadPart;
+
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping_ == NULL) return;
+
+    data_ = (const unsigned char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+#else
+    fd_ = open(path.c_str(), O_RDONLY);
+    if(fd_ == -1) return;
+
+    struct stat st;
+    if(fstat(fd_, &st) == -1 || st.st_size == 0) return;
+    size_ = (size_t)st.st_size;
+
+    void *addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(addr == MAP_FAILED) return;
+
+    // Records are visited front to back, let the kernel read ahead aggressively
+    madvise(addr, size_, MADV_SEQUENTIAL);
+
+    data_ = (const unsigned char *)addr;
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if(data_ != NULL) UnmapViewOfFile(data_);
+    if(mapping_ != NULL) CloseHandle(mapping_);
+    if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if(data_ != NULL) munmap((void *)data_, size_);
+    if(fd_ != -1) close(fd_);
+#endif
+  }
+
+  bool is_open() const { return data_ != NULL; }
+
+  const unsigned char* data() const { return data_; }
+
+  size_t size() const { return size_; }
+
+  // Drops the pages of [begin, end) that have already been consumed so a long sequential read keeps a bounded footprint
+  void release(size_t begin, size_t end) const {
+#ifndef _WIN32
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    begin = (begin + page - 1) / page * page;
+    end = end / page * page;
+    if(data_ != NULL && end > begin && end <= size_){
+      madvise((void *)(data_ + begin), end - begin, MADV_DONTNEED);
+    }
+#else
+    (void)begin; (void)end;
+#endif
+  }
+
+  // Asks the kernel to start reading [begin, end) in the background
+  void prefetch(size_t begin, size_t end) const {
+#ifndef _WIN32
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    begin = begin / page * page;
+    end = std::min(end, size_);
+    if(data_ != NULL && end > begin){
+      madvise((void *)(data_ + begin), end - begin, MADV_WILLNEED);
+    }
+#else
+    (void)begin; (void)end;
+#endif
+  }
+
+  // Records are visited in no particular order, only the pages actually touched should be read
+  void random_access() const {
+#ifndef _WIN32
+    if(data_ != NULL){
+      madvise((void *)data_, size_, MADV_RANDOM);
+    }
+#endif
+  }
+
+private:
+
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const unsigned char *data_;
+  size_t size_;
+
+#ifdef _WIN32
+  HANDLE file_;
+  HANDLE mapping_;
+#else
+  int fd_;
+#endif
+
+};
+
+// Unaligned little-endian load of a fixed-width field at byte offset 'p'
+template <typename T>
+inline T read_le(const unsigned char *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+// Unaligned little-endian store, the counterpart of read_le used when writing logs
+template <typename T>
+inline void write_le(unsigned char *p, T value) {
+  std::memcpy(p, &value, sizeof(T));
+}
+
+#endif
@@ -0,0 +1,93 @@
+// Optional counters and timers on the reader hot paths.
+// They are compiled in only when SONAR_PROFILE is defined, otherwise the macros expand to nothing and
+// their arguments are never evaluated
+// Kenneth Thorø Martinsen
+
+#ifndef SONAR_SLX_PROFILE_H
+#define SONAR_SLX_PROFILE_H
+
+enum ProfileCounter {
+  PROFILE_FILE_BYTES, PROFILE_RECORDS_SCANNED, PROFILE_RECORDS_DECODED, PROFILE_HEADER_BYTES, PROFILE_FRAME_BYTES,
+  PROFILE_REALLOCATIONS, PROFILE_PREFETCH_BYTES, PROFILE_COUNTERS
+};
+
+enum ProfileStage {
+  PROFILE_INDEX, PROFILE_LAYOUT, PROFILE_DECODE, PROFILE_DATAFRAME, PROFILE_STAGES
+};
+
+#ifdef SONAR_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Totals since the last reset, shared by all threads
+struct SlxProfile {
+
+  std::atomic < uint64_t > counters[PROFILE_COUNTERS];
+  std::atomic < uint64_t > nanoseconds[PROFILE_STAGES];
+  long minor_faults, major_faults;
+
+  void reset() {
+    for(int i = 0; i < PROFILE_COUNTERS; i++) counters[i] = 0;
+    for(int i = 0; i < PROFILE_STAGES; i++) nanoseconds[i] = 0;
+    page_faults(minor_faults, major_faults);
+  }
+
+  // Page faults of the process, a major fault is a page of the mapped log that had to be read from disk
+  static void page_faults(long& minor, long& major) {
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    minor = usage.ru_minflt;
+    major = usage.ru_majflt;
+#else
+    minor = 0;
+    major = 0;
+#endif
+  }
+
+};
+
+inline SlxProfile& slx_profile_state() {
+  static SlxProfile profile;
+  return(profile);
+}
+
+// Adds the time until the end of the enclosing scope to a stage, stages running on several threads are timed once
+// around the whole run
+class ProfileTimer {
+
+public:
+
+  explicit ProfileTimer(ProfileStage stage) : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+
+  ~ProfileTimer() {
+    slx_profile_state().nanoseconds[stage_] +=
+      std::chrono::duration_cast < std::chrono::nanoseconds >(std::chrono::steady_clock::now() - start_).count();
+  }
+
+private:
+
+  ProfileStage stage_;
+  std::chrono::steady_clock::time_point start_;
+
+};
+
+#define PROFILE_RESET() slx_profile_state().reset()
+#define PROFILE_COUNT(counter, n) (slx_profile_state().counters[counter] += (uint64_t)(n))
+#define PROFILE_STAGE(stage) ProfileTimer profile_timer_(stage)
+
+#else
+
+#define PROFILE_RESET() ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)0)
+#define PROFILE_STAGE(stage) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+// Streaming access to sonar logs, a bounded number of records is decoded per call
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include "slx_decode.h"
+
+using namespace Rcpp;
+
+// Open log and position of the next record, kept alive on the R side through an external pointer.
+// The TotalLength of the last record read is kept as well, so the first record of a chunk is still checked
+// against the one before it
+struct SlxReader {
+
+  explicit SlxReader(const std::string& path) : file(path), recStart(FILE_HEADER_SIZE), previous(0), released(0) {}
+
+  MappedFile file;
+  uint16_t format, version, blockSize;
+  SlxKeyFields f;
+  SlxFilter filter;
+  size_t recStart;
+  uint16_t previous;
+  size_t released;
+
+};
+
+// [[Rcpp::export]]
+
+SEXP slx_open(std::string path, Nullable<IntegerVector> channels=R_NilValue,
+              Nullable<NumericVector> time_range=R_NilValue, Nullable<NumericVector> bbox=R_NilValue) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  XPtr<SlxReader> reader(new SlxReader(full_path), true);
+
+  if(!reader->file.is_open() || reader->file.size() < FILE_HEADER_SIZE){
+    stop("Unable to open file: " + full_path);
+  }
+
+  const unsigned char *base = reader->file.data();
+
+  reader->format = read_le<uint16_t>(base);
+  reader->version = read_le<uint16_t>(base + 2);
+  reader->blockSize = read_le<uint16_t>(base + 4);
+
+  if(!known_format(reader->format)){
+    stop("The file appears to be neither '.sl2' or '.sl3'.");
+  }
+
+  reader->f = key_fields(reader->format);
+  reader->filter = make_filter(channels, time_range, bbox);
+
+  return(reader);
+
+}
+
+// [[Rcpp::export]]
+
+SEXP slx_next_chunk(SEXP reader, int n, bool read_frames=false) {
+
+  XPtr<SlxReader> r(reader);
+
+  if(r.get() == NULL){
+    stop("The reader has been closed.");
+  }
+
+  if(n <= 0){
+    stop("The chunk size must be positive.");
+  }
+
+  const unsigned char *base = r->file.data();
+  const size_t size = r->file.size();
+
+  size_t chunkStart = r->recStart;
+
+  SlxScanner scanner(base, size, r->f, r->filter, r->recStart);
+  scanner.previous = r->previous;
+
+  std::vector < size_t > offsets = scanner.scan(n);
+
+  r->recStart = scanner.pos;
+  r->previous = scanner.previous;
+
+  if(offsets.empty()){
+    if(!scanner.skipped.empty()){
+      warning("Skipped damaged part(s) at the end of the log, no records followed them");
+    }
+    return(R_NilValue);
+  }
+
+  size_t m = offsets.size();
+
+  //The chunk is decoded straight into the columns handed back to R
+  SlxColumns cols(m);
+
+  RawVector frames;
+  NumericVector frame_offsets;
+
+  if(read_frames){
+    frame_offsets = NumericVector(no_init(m));
+    frames = RawVector(no_init((R_xlen_t)frame_layout(base, r->format, offsets, frame_offsets.begin())));
+  }
+
+  unsigned char *frames_ptr = read_frames ? frames.begin() : NULL;
+  const double *frame_offsets_ptr = read_frames ? frame_offsets.begin() : NULL;
+
+  decode_records(r->format, base, size, offsets, 0, m, cols, frames_ptr, frame_offsets_ptr);
+
+  DataFrame out = slx_dataframe(cols, r->format, r->version, r->blockSize);
+
+  if(read_frames){
+    out.attr("frames") = frames;
+    out.attr("frame_offsets") = frame_offsets;
+  }
+
+  out.attr("skipped") = skipped_dataframe(scanner.skipped);
+
+  //Everything before the next record has been copied out, hand those pages back and
+  //start reading the next chunk while the caller works on this one
+  r->file.release(r->released, r->recStart);
+  r->released = r->recStart;
+  r->file.prefetch(r->recStart, r->recStart + (r->recStart - chunkStart));
+
+  return(out);
+
+}
+
+// [[Rcpp::export]]
+
+void slx_close(SEXP reader) {
+
+  XPtr<SlxReader> r(reader);
+
+  r.release();
+
+}
+
+// [[Rcpp::export]]
+
+DataFrame slx_tail(std::string path, double from, int previous=0, bool read_frames=false,
+                   Nullable<IntegerVector> channels=R_NilValue, Nullable<NumericVector> time_range=R_NilValue,
+                   Nullable<NumericVector> bbox=R_NilValue) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  //Mapping is lazy, only the pages after 'from' are touched so the cost follows the new data
+  MappedFile file(full_path);
+
+  if(!file.is_open() || file.size() < FILE_HEADER_SIZE){
+    stop("Unable to open file: " + full_path);
+  }
+
+  const unsigned char *base = file.data();
+  const size_t size = file.size();
+
+  uint16_t format = read_le<uint16_t>(base);
+  uint16_t version = read_le<uint16_t>(base + 2);
+  uint16_t blockSize = read_le<uint16_t>(base + 4);
+
+  if(!known_format(format)){
+    stop("The file appears to be neither '.sl2' or '.sl3'.");
+  }
+
+  if(!(from >= 0)){
+    stop("'from' must be a non-negative byte offset");
+  }
+
+  if(from > size){
+    stop("The file is shorter than the offset to continue from, it may have been replaced");
+  }
+
+  if(previous < 0 || previous > 0xFFFF){
+    stop("'previous' must be the length of the record before 'from', or 0 if unknown");
+  }
+
+  //Only complete records up to the current end of the log are decoded, the offset of the first record not returned
+  //is handed back as "next_offset" and is where the next call continues. The length of the record before it is
+  //handed back as "previous_length", so the first record of the next call is checked against it as in one scan
+  size_t recStart = std::max((size_t)from, (size_t)FILE_HEADER_SIZE);
+
+  file.prefetch(recStart, size);
+
+  SlxScanner scanner(base, size, key_fields(format), make_filter(channels, time_range, bbox), recStart);
+  scanner.previous = (uint16_t)previous;
+  scanner.complete_only = true;
+
+  std::vector < size_t > offsets = scanner.scan((size_t)-1);
+
+  size_t m = offsets.size();
+
+  SlxColumns cols(m);
+
+  RawVector frames;
+  NumericVector frame_offsets;
+
+  if(read_frames){
+    frame_offsets = NumericVector(no_init(m));
+    frames = RawVector(no_init((R_xlen_t)frame_layout(base, format, offsets, frame_offsets.begin())));
+  }
+
+  unsigned char *frames_ptr = read_frames ? frames.begin() : NULL;
+  const double *frame_offsets_ptr = read_frames ? frame_offsets.begin() : NULL;
+
+  decode_records(format, base, size, offsets, 0, m, cols, frames_ptr, frame_offsets_ptr);
+
+  DataFrame out = slx_dataframe(cols, format, version, blockSize);
+
+  if(read_frames){
+    out.attr("frames") = frames;
+    out.attr("frame_offsets") = frame_offsets;
+  }
+
+  out.attr("next_offset") = (double)scanner.pos;
+  out.attr("previous_length") = (int)scanner.previous;
+  out.attr("skipped") = skipped_dataframe(scanner.skipped);
+
+  return(out);
+
+}
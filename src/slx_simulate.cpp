@@ -0,0 +1,179 @@
+// Synthetic '.sl2' and '.sl3' logs written with the same layouts the readers decode, for testing and benchmarks
+// Kenneth Thorø Martinsen
+
+#include <Rcpp.h>
+
+#include <fstream>
+#include <random>
+
+#include "slx_decode.h"
+
+using namespace Rcpp;
+
+// Validity bits set in Flags, see decode_records
+#define SIMULATE_FLAGS ((1 << 0) | (1 << 1) | (1 << 9) | (1 << 10) | (1 << 12) | (1 << 14) | (1 << 15))
+
+// One ping per channel every 'SIMULATE_PING_MS' while the boat follows a slow curve at constant speed
+#define SIMULATE_PING_MS 100
+#define SIMULATE_SPEED 2.0
+
+struct SlxSimulator {
+
+  std::ofstream *out;
+  size_t n, frame_length;
+  std::vector < int > channels;
+  uint32_t seed;
+  double lon, lat;
+  size_t bytes;
+
+  template <typename Layout>
+  void visit() {
+
+    typedef typename Layout::EchoLengthType EchoLengthType;
+
+    size_t total = Layout::HeaderSize + frame_length;
+
+    if(total > 0xFFFF){
+      stop("'frame_length' is too long, records are limited to 65535 bytes");
+    }
+
+    std::mt19937 rng(seed);
+    std::vector < unsigned char > rec(total);
+
+    double x = lon_to_lowrance(lon), y = lat_to_lowrance(lat);
+
+    //Mercator metres per metre on the ground
+    double step = SIMULATE_SPEED * SIMULATE_PING_MS / 1000.0 / std::cos(lat * M_PI / 180);
+
+    size_t position = FILE_HEADER_SIZE;
+    uint16_t previous = 0;
+
+    std::vector < uint32_t > campaign(6, 0);
+
+    for(size_t i = 0; i < n; i++){
+
+      size_t ping = i / channels.size();
+      int channel = channels[i % channels.size()];
+      bool sidescan = channel >= 3;
+
+      double t = ping * SIMULATE_PING_MS / 1000.0;
+      double heading = std::fmod(0.3 + t / 600.0, 2 * M_PI);
+      double depth = 6 + 3 * std::sin(t / 60.0);
+      double max_range = sidescan ? 30 : 5 * std::ceil(depth * 1.5 / 5);
+
+      //The boat moves along its heading between pings, Lowrance y grows northwards
+      if(i % channels.size() == 0 && i > 0){
+        x += step * std::sin(heading);
+        y += step * std::cos(heading);
+      }
+
+      std::fill(rec.begin(), rec.end(), 0);
+      unsigned char *h = &rec[0];
+
+      write_le<uint32_t>(h + Layout::PositionOfFirstByte, (uint32_t)position);
+      write_le<uint16_t>(h + Layout::TotalLength, (uint16_t)total);
+      write_le<uint16_t>(h + Layout::PreviousLength, previous);
+      write_le<uint16_t>(h + Layout::SurveyType, (uint16_t)channel);
+      write_le<EchoLengthType>(h + Layout::OriginalLengthOfEchoData, (EchoLengthType)frame_length);
+      write_le<uint32_t>(h + Layout::NumberOfCampaignInThisType, campaign[channel]++);
+      write_le<float>(h + Layout::MinRange, 0);
+      write_le<float>(h + Layout::MaxRange, (float)(max_range * FEET_PER_METRE));
+      write_le<uint8_t>(h + Layout::Frequency, (uint8_t)(sidescan ? 8 : channel));
+      write_le<uint32_t>(h + Layout::HardwareTime, (uint32_t)(ping * SIMULATE_PING_MS));
+      write_le<float>(h + Layout::WaterDepth, (float)(depth * FEET_PER_METRE));
+      write_le<float>(h + Layout::GNSSSpeed, (float)(SIMULATE_SPEED * KNOTS_PER_MS));
+      write_le<float>(h + Layout::WaterTemperature, (float)(15 + std::sin(t / 300.0)));
+      write_le<int32_t>(h + Layout::XLowrance, (int32_t)std::floor(x));
+      write_le<int32_t>(h + Layout::YLowrance, (int32_t)std::floor(y));
+      write_le<float>(h + Layout::WaterSpeed, (float)(SIMULATE_SPEED * KNOTS_PER_MS));
+      write_le<float>(h + Layout::GNSSHeading, (float)heading);
+      write_le<float>(h + Layout::GNSSAltitude, 0);
+      write_le<float>(h + Layout::MagneticHeading, (float)heading);
+      write_le<uint16_t>(h + Layout::Flags, SIMULATE_FLAGS);
+      write_le<uint32_t>(h + Layout::Milliseconds, (uint32_t)(ping * SIMULATE_PING_MS));
+
+      //Echo: weak noise in the water column, a strong return at the bottom fading below it.
+      //Sidescan frames hold the port side reversed followed by the starboard side
+      unsigned char *frame = h + Layout::HeaderSize;
+      double bottom = depth / max_range;
+
+      for(size_t j = 0; j < frame_length; j++){
+
+        double r = sidescan ? std::fabs((j + 0.5) / frame_length * 2 - 1) : (j + 0.5) / frame_length;
+        double value = rng() % 24;
+
+        if(r >= bottom){
+          value += 200 * std::exp(-(r - bottom) * (sidescan ? 3 : 12)) + rng() % 32;
+        }
+
+        frame[j] = (unsigned char)std::min(value, 255.0);
+      }
+
+      out->write((const char *)h, total);
+
+      position += total;
+      previous = (uint16_t)total;
+    }
+
+    bytes = position;
+  }
+
+};
+
+// [[Rcpp::export]]
+
+double slx_simulate(std::string path, double n, IntegerVector channels, int format=2,
+                    int frame_length=1024, int seed=1, double lon=10, double lat=56) {
+
+  std::string full_path = std::string(R_ExpandFileName(path.c_str()));
+
+  if(!known_format(format)){
+    stop("'format' must be 2 (sl2) or 3 (sl3)");
+  }
+
+  if(channels.size() == 0){
+    stop("At least one channel is required");
+  }
+
+  for(R_xlen_t i = 0; i < channels.size(); i++){
+    if(channels[i] < 0 || channels[i] > 5){
+      stop("Channels must be SurveyType codes between 0 and 5");
+    }
+  }
+
+  if(!(n >= 0) || frame_length < 0){
+    stop("'n' and 'frame_length' must not be negative");
+  }
+
+  std::ofstream out(full_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if(!out){
+    stop("Unable to write file: " + full_path);
+  }
+
+  unsigned char header[FILE_HEADER_SIZE];
+  std::memset(header, 0, FILE_HEADER_SIZE);
+  write_le<uint16_t>(header, (uint16_t)format);
+  write_le<uint16_t>(header + 2, (uint16_t)(format == 2 ? 0 : 1));
+  write_le<uint16_t>(header + 4, 3200);
+  out.write((const char *)header, FILE_HEADER_SIZE);
+
+  SlxSimulator sim;
+  sim.out = &out;
+  sim.n = (size_t)n;
+  sim.frame_length = (size_t)frame_length;
+  sim.channels.assign(channels.begin(), channels.end());
+  sim.seed = (uint32_t)seed;
+  sim.lon = lon;
+  sim.lat = lat;
+  sim.bytes = FILE_HEADER_SIZE;
+
+  visit_layout(format, sim);
+
+  if(!out.good()){
+    stop("Unable to write file: " + full_path);
+  }
+
+  return((double)sim.bytes);
+
+}